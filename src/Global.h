@@ -6,6 +6,13 @@ class Global {
 public:
     static void update();
 
+    // 地图像素 y 对应的遮挡深度（NDC z）：y 越大越靠前，地图与精灵共用。
+    // y 在 [0, 65536] 内线性映射到 [0, -0.9]，留出 -0.9 之前的范围，深度清除值 1 总在最后
+    static float occlusionDepth(float y) {
+        float t = y < 0.f ? 0.f : (y > 65536.f ? 1.f : y / 65536.f);
+        return -0.9f * t;
+    }
+
 public:
     static int frameID;
     static int fps;
@@ -18,6 +18,7 @@
 
 #include "Global.h"
 #include "xy2/mapx.h"
+#include "xy2/walkgrid.h"
 
 Window::Window() {
     glfwSetErrorCallback(ErrorCallback);
@@ -164,6 +165,32 @@ void Window::drawUI() {
             updateFileList(m_fileListStatus.currentDirectory.parent_path());
         }
         ImGui::SameLine();
+        auto &walkGridExport = m_walkGridExport;
+        if (walkGridExport.task.valid() &&
+            walkGridExport.task.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            walkGridExport.task.get();
+            if (walkGridExport.directory == m_fileListStatus.currentDirectory)
+                updateFileList(walkGridExport.directory);
+        }
+        if (walkGridExport.task.valid()) {
+            int total = walkGridExport.progress.Total, done = walkGridExport.progress.Done;
+            auto text = std::to_string(done) + "/" + std::to_string(total);
+            ImGui::ProgressBar(total ? (float) done / total : 0.f, {120.f, 0.f}, text.c_str());
+        } else if (ImGui::Button("导出可行走网格")) {
+            // 当前目录下全部地图在后台导出到 walkgrid 子目录
+            auto dir = m_fileListStatus.currentDirectory;
+            walkGridExport.progress.Total = 0;
+            walkGridExport.progress.Done = 0;
+            walkGridExport.directory = dir;
+            walkGridExport.task = std::async(std::launch::async, [dir, progress = &walkGridExport.progress]() {
+                return WalkGrid::ExportDirectory(dir.string(), (dir / "walkgrid").string(), 0, progress);
+            });
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("挂载全部 WDF")) {
+            m_scene->getShape().mountWdfDirectory(m_fileListStatus.currentDirectory.string());
+        }
+        ImGui::SameLine();
 
         ImGui::Text((char *) m_fileListStatus.currentDirectory.u8string().c_str());
         ImGui::Separator();
@@ -186,6 +213,11 @@ void Window::drawUI() {
                     path = m_fileListStatus.fileList[i].second;
                     flag = 3;
                 }
+                // 名称列表，用于解析当前 WDF 的条目路径
+                if (m_fileListStatus.fileList[i].first.ends_with(".lst")) {
+                    path = m_fileListStatus.fileList[i].second;
+                    flag = 4;
+                }
             }
         }
 
@@ -195,6 +227,8 @@ void Window::drawUI() {
             m_scene->getMap().loadMap(path.string());
         } else if (flag == 3) {
             m_scene->getShape().loadWdf(path.string());
+        } else if (flag == 4) {
+            m_scene->getShape().loadWdfNames(path.string());
         }
 
         ImGui::EndChild();
@@ -209,9 +243,31 @@ void Window::drawUI() {
                                  ImGuiCond_Appearing);
 
         if (ImGui::Begin("WDF", &m_wdfWindowVisible)) {
-            for (int i = 0; i < m_scene->getShape().wasList().size(); i++) {
-                if (ImGui::Selectable(m_scene->getShape().wasList()[i].first.c_str())) {
-                    m_scene->getShape().loadWas(m_scene->getShape().wasList()[i].second);
+            const WdfVfs &vfs = m_scene->getShape().vfs();
+            auto entries = vfs.entries();
+            const auto &stats = vfs.mountStats();
+            ImGui::Text("%zu 个文件, %zu 条, 覆盖 %zu", stats.archives, entries.size(), stats.overridden);
+            ImGui::Text("挂载 %.1f ms, 索引 %.2f MB", stats.seconds * 1000.0, vfs.memoryBytes() / 1024.0 / 1024.0);
+            if (ImGui::Button("识别全部类型"))
+                vfs.sniffAll();
+            ImGui::SameLine();
+            ImGui::Text("%zu/%zu", vfs.sniffedCount(), stats.entries);
+
+            // 只为可见的行识别类型
+            ImGuiListClipper clipper;
+            clipper.Begin((int) entries.size());
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                    char label[320];
+                    const char *type = wasTypeName(vfs.getType(entries[i]));
+                    std::string_view name = vfs.getName(entries[i]);
+                    if (name.empty())
+                        snprintf(label, sizeof(label), "[%s] %X", type, entries[i].hash);
+                    else
+                        snprintf(label, sizeof(label), "[%s] %.*s##%X", type, (int) name.size(), name.data(), entries[i].hash);
+                    if (ImGui::Selectable(label)) {
+                        m_scene->getShape().loadWas(entries[i].hash);
+                    }
                 }
             }
             ImGui::End();
@@ -231,7 +287,10 @@ void Window::drawUI() {
         ImGui::SeparatorText("地图:");
         ImGui::Checkbox("显示地图", &m_scene->mapTileVisible);
         ImGui::Checkbox("显示遮罩", &m_scene->mapMaskVisible);
+        ImGui::Checkbox("高亮遮罩", &m_scene->getMap().maskHighlight);
+        ImGui::Checkbox("矢量遮罩", &m_scene->getMap().maskPolygon);
         ImGui::Checkbox("显示 Cell", &m_scene->mapCellVisible);
+        ImGui::Checkbox("遮罩遮挡精灵", &m_scene->spriteOcclusion);
         ImGui::SliderInt("Cell 点大小", &m_scene->getMap().pointSize, 1, 10);
         ImGui::Separator();
         ImGui::LabelText("地图宽", "%d", m_scene->getMap().mapWidth());
@@ -240,6 +299,30 @@ void Window::drawUI() {
         ImGui::LabelText("Block 列", "%d", m_scene->getMap().mapBockColCount());
         ImGui::LabelText("Block 宽", "%d", m_scene->getMap().mapBlockWidth());
         ImGui::LabelText("Block 高", "%d", m_scene->getMap().mapBlockHeight());
+        ImGui::Separator();
+        const auto &maskStats = m_scene->getMap().maskStats();
+        ImGui::LabelText("遮罩数", "%d", m_scene->getMap().maskCount());
+        ImGui::LabelText("遮罩常驻", "%d", maskStats.resident);
+        ImGui::LabelText("遮罩可见", "%d", maskStats.visible);
+        ImGui::LabelText("遮罩绘制", "%d", maskStats.drawn);
+        ImGui::LabelText("遮罩 DrawCall", "%d", maskStats.drawCalls);
+        ImGui::LabelText("遮罩图集页", "%d", maskStats.pages);
+        ImGui::LabelText("遮罩显存", "%.2f MB", maskStats.residentBytes / 1024.0 / 1024.0);
+        ImGui::LabelText("遮罩加载/淘汰", "%d / %d", maskStats.loads, maskStats.evictions);
+        if (auto polygonStats = m_scene->getMap().polygonStats()) {
+            ImGui::LabelText("矢量遮罩内存", "%.2f / %.2f MB", polygonStats->PolygonBytes / 1024.0 / 1024.0,
+                             polygonStats->BitmapBytes / 1024.0 / 1024.0);
+            ImGui::LabelText("矢量遮罩误差", "%.3f%% (最大 %.2f%%)",
+                             polygonStats->CoveredPixels ? 100.0 * polygonStats->MismatchPixels / polygonStats->CoveredPixels : 0.0,
+                             polygonStats->MaxMismatch * 100.0);
+        }
+
+        // 精灵
+        ImGui::SeparatorText("精灵:");
+        float hue = m_scene->getShape().hue();
+        if (ImGui::SliderFloat("色相", &hue, -180.f, 180.f, "%.0f"))
+            m_scene->getShape().setHue(hue);
+        ImGui::LabelText("精灵图显存", "%.2f MB", m_scene->getShape().textureBytes() / 1024.0 / 1024.0);
 
         ImGui::End();
     }
@@ -291,7 +374,7 @@ int Window::eventLoop() {
     while (!m_shouldClose) {
         Global::update();
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         m_scene->drawScene();
 
         drawUI();
@@ -1,9 +1,11 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 #include <filesystem>
+#include <future>
 #include <string>
 #include <vector>
 
+#include "xy2/walkgrid.h"
 #include "xy2/wdf.h"
 
 struct GLFWwindow;
@@ -57,6 +59,13 @@ private:
         std::vector<std::pair<std::string, std::filesystem::path>> fileList;
         int seletedIndex{-1};
     } m_fileListStatus;
+
+    // 后台导出可行走网格，完成后刷新导出时所在的目录
+    struct {
+        WalkGrid::ExportProgress progress;
+        std::filesystem::path directory;
+        std::future<int> task;
+    } m_walkGridExport;
 };
 
 #endif //WINDOW_H
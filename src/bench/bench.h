@@ -0,0 +1,54 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 无窗口基准测试：XYBench <命令> <地图.map> [参数...]
+
+class Timer {
+public:
+    Timer() : m_start(std::chrono::steady_clock::now()) {
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// args[i] 不存在时返回默认值
+inline long long argInt(const std::vector<std::string> &args, size_t i, long long def) {
+    return i < args.size() ? std::stoll(args[i]) : def;
+}
+
+inline double toMB(size_t bytes) { return bytes / 1024.0 / 1024.0; }
+
+// 将文件移出页缓存，须在解除映射之后调用；平台不支持时返回 false
+bool dropPageCache(const std::vector<std::string> &paths);
+
+int pathBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+int losBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+int flowBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+int stressBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+int hashBench(const std::string &namesPath, const std::vector<std::string> &args);
+
+int vfsBench(const std::string &dir, const std::vector<std::string> &args);
+
+int loadBench(const std::string &dir, const std::vector<std::string> &args);
+
+int wasBench(const std::string &dir, const std::vector<std::string> &args);
+
+int queryBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+int occlusionBench(const std::string &mapPath, const std::vector<std::string> &args);
+
+
+#endif //BENCH_H
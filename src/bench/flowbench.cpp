@@ -0,0 +1,125 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "xy2/flowfield.h"
+#include "xy2/mapx.h"
+#include "xy2/pathfinder.h"
+#include "xy2/walkgrid.h"
+
+// 将地图的 Cell 网格平铺 scale x scale 份，一个流场对应多个单位，对比逐个 A*
+int flowBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long maxAgents = argInt(args, 0, 100000);
+    int threads = argInt(args, 1, 0);
+
+    MapX map(mapPath, 0);
+    int mapCols = map.GetCellColCount(), mapRows = map.GetCellRowCount();
+    if (mapCols <= 0)
+        return 1;
+
+    long long mismatch = 0;
+    for (int scale = 1; scale <= 4; scale *= 2) {
+        int cols = mapCols * scale, rows = mapRows * scale;
+        std::vector<uint32_t> cells((size_t) cols * rows);
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++)
+                cells[(size_t) y * cols + x] = map.GetCell()[(y % mapRows) * mapCols + x % mapCols];
+        }
+        auto walkable = [&](int x, int y) { return !WalkGrid::IsBlockedCell(cells[(size_t) y * cols + x]); };
+
+        // 目标取离中心最近的可走格
+        FlowField::Point goal{-1, -1};
+        long long best = -1;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++) {
+                long long d = (long long) (x - cols / 2) * (x - cols / 2) + (long long) (y - rows / 2) * (y - rows / 2);
+                if (walkable(x, y) && (best < 0 || d < best)) {
+                    best = d;
+                    goal = {x, y};
+                }
+            }
+        }
+        if (best < 0)
+            return 1;
+
+        FlowField serial(cells.data(), cols, rows), flow(cells.data(), cols, rows);
+        Timer serialTimer;
+        serial.SetGoal(goal, 0, 1);
+        double serialSeconds = serialTimer.seconds();
+        Timer fullTimer;
+        flow.SetGoal(goal, 0, threads);
+        double fullSeconds = fullTimer.seconds();
+        long long differ = 0;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++)
+                differ += serial.GetCost(x, y) != flow.GetCost(x, y);
+        }
+        size_t reachable = flow.GetTouchedCount();
+        mismatch += differ;
+
+        // 目标每两次移动一格，原地不动时直接跳过；分别只重算半径 64 内的区域与整张地图（radius 0，即完整重建）
+        const int MOVES = 100, RADIUS = 64;
+        auto moveGoal = [&](int radius, int moves, int &moved) {
+            FlowField field(cells.data(), cols, rows);
+            moved = 0;
+            Timer moveTimer;
+            for (int i = 0; i < moves; i++) {
+                FlowField::Point next{std::min(goal.X + i / 2, cols - 1), goal.Y};
+                moved += field.SetGoal(next, radius, threads);
+            }
+            return moveTimer.seconds();
+        };
+        int moved, fullMoved;
+        double moveSeconds = moveGoal(RADIUS, MOVES, moved);
+        double fullMoveSeconds = moveGoal(0, MOVES / 5, fullMoved);
+
+        printf("map x%d     %d x %d cells, %zu reachable, field %.2f MB, %lld mismatches\n", scale, cols, rows,
+               reachable, toMB(flow.MemoryBytes()), differ);
+        printf("  build    1 thread %.2f ms, %d threads %.2f ms\n", serialSeconds * 1e3,
+               threads > 0 ? threads : (int) std::thread::hardware_concurrency(), fullSeconds * 1e3);
+        printf("  move     radius %d, %d/%d rebuilt, %.3f ms avg\n", RADIUS, moved, MOVES,
+               moveSeconds * 1e3 / std::max(moved, 1));
+        printf("  move     full map, %d/%d rebuilt, %.3f ms avg\n", fullMoved, MOVES / 5,
+               fullMoveSeconds * 1e3 / std::max(fullMoved, 1));
+
+        // 单位随机散布在可达格上，每 tick 沿流场走一步
+        std::mt19937 rng(1);
+        std::vector<FlowField::Point> agents(maxAgents), next(maxAgents);
+        for (auto &agent: agents) {
+            do {
+                agent = {(int) (rng() % cols), (int) (rng() % rows)};
+            } while (flow.GetCost(agent.X, agent.Y) == FlowField::UNREACHABLE);
+        }
+        for (long long count = 1000; count <= maxAgents; count *= 10) {
+            const int TICKS = 20;
+            std::vector<FlowField::Point> positions(agents.begin(), agents.begin() + count);
+            Timer tickTimer;
+            for (int tick = 0; tick < TICKS; tick++) {
+                flow.NextBatch(positions, std::span(next).first(count));
+                std::copy(next.begin(), next.begin() + count, positions.begin());
+            }
+            double tickSeconds = tickTimer.seconds() / TICKS;
+            printf("  agents   %-8lld %.3f ms/tick, %.1f M lookups/s\n", count, tickSeconds * 1e3,
+                   count / tickSeconds / 1e6);
+        }
+
+        // 同样的单位各自寻路所需的时间
+        if (scale == 1) {
+            Timer pathTimer;
+            PathFinder finder(cells.data(), cols, rows, threads);
+            double pathBuildSeconds = pathTimer.seconds();
+            long long paths = std::min(maxAgents, 1000ll);
+            std::vector<PathFinder::Point> path;
+            Timer findTimer;
+            for (long long i = 0; i < paths; i++)
+                finder.Find({agents[i].X, agents[i].Y}, {goal.X, goal.Y}, path);
+            double findSeconds = findTimer.seconds();
+            printf("  hpa*     %lld agents %.2f ms (+%.2f ms build)\n", paths, findSeconds * 1e3,
+                   pathBuildSeconds * 1e3);
+        }
+    }
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+#include "bench.h"
+
+#include "xy2/wdf.h"
+#include "xy2/wdfhash.h"
+
+// 名称列表（每行一个路径）逐个 wdfHash 与 wdfHashBatch 对比，给出 wdf 时统计命中的条目数
+int hashBench(const std::string &namesPath, const std::vector<std::string> &args)
+{
+    std::string wdfPath = args.size() > 0 ? args[0] : "";
+    int threads = argInt(args, 1, 0);
+
+    std::string text;
+    std::vector<std::string_view> paths;
+    if (!Wdf::readNameList(namesPath, text, paths))
+        return 1;
+    if (paths.empty())
+        return 1;
+
+    std::vector<uint32_t> scalar(paths.size()), single(paths.size()), batch(paths.size());
+    Timer scalarTimer;
+    for (size_t i = 0; i < paths.size(); i++)
+        scalar[i] = wdfHash(paths[i]);
+    double scalarSeconds = scalarTimer.seconds();
+
+    Timer singleTimer;
+    wdfHashBatch(paths, single, 1);
+    double singleSeconds = singleTimer.seconds();
+
+    Timer batchTimer;
+    wdfHashBatch(paths, batch, threads);
+    double batchSeconds = batchTimer.seconds();
+
+    long long mismatch = 0;
+    for (size_t i = 0; i < paths.size(); i++)
+        mismatch += scalar[i] != single[i] || scalar[i] != batch[i];
+
+    printf("names      %zu, %lld mismatches\n", paths.size(), mismatch);
+    printf("scalar     %.2f M/s\n", paths.size() / scalarSeconds / 1e6);
+    printf("batch x1   %.2f M/s\n", paths.size() / singleSeconds / 1e6);
+    printf("batch      %.2f M/s\n", paths.size() / batchSeconds / 1e6);
+
+    if (!wdfPath.empty()) {
+        Wdf wdf;
+        if (!wdf.load(wdfPath))
+            return 1;
+        Timer resolveTimer;
+        size_t named = wdf.addNames(paths, threads);
+        double resolveSeconds = resolveTimer.seconds();
+        printf("resolve    %zu/%zu entries named in %.3f s\n", named, wdf.getWasInfos().size(), resolveSeconds);
+    }
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include "bench.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "xy2/parallel.h"
+#include "xy2/wdfloader.h"
+#include "xy2/wdfvfs.h"
+
+namespace {
+    // 代替解码的 CPU 工作：逐字节 FNV-1a
+    uint32_t checksum(std::span<const uint8_t> data) {
+        uint32_t h = 2166136261u;
+        for (uint8_t b: data)
+            h = (h ^ b) * 16777619u;
+        return h;
+    }
+
+    WdfLoader::Task checksumEntry(WdfLoader &loader, const WdfVfs &vfs, const WdfVfs::Entry &entry,
+                                  std::atomic<uint64_t> &sum) {
+        auto data = co_await loader.read(vfs, entry);
+        sum += checksum(data);
+    }
+}
+
+// 读取目录下全部 wdf 的所有条目：同步读取对比协程加载器，两者在相同线程数下比较，
+// 每次运行前重新挂载并清空页缓存，避免先运行的一方替后者预热
+int loadBench(const std::string &dir, const std::vector<std::string> &args)
+{
+    int threads = argInt(args, 0, 0);
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> paths;
+    size_t entryCount = 0, bytes = 0;
+    {
+        WdfVfs vfs;
+        if (!vfs.mountDirectory(dir, threads))
+            return 1;
+        for (size_t i = 0; i < vfs.archiveCount(); i++)
+            paths.push_back(vfs.archive(i).getPath());
+        auto entries = vfs.entries();
+        entryCount = entries.size();
+        for (const auto &entry: entries)
+            bytes += vfs.getData(entry).size();
+    }
+
+    bool cold = false;
+    auto run = [&](const std::function<uint64_t(const WdfVfs &)> &fn, uint64_t &sum) {
+        WdfVfs vfs;
+        cold = dropPageCache(paths);
+        vfs.mountDirectory(dir, threads);
+        Timer timer;
+        sum = fn(vfs);
+        return timer.seconds();
+    };
+
+    auto syncRead = [](int readThreads) {
+        return [readThreads](const WdfVfs &vfs) -> uint64_t {
+            auto entries = vfs.entries();
+            std::atomic<uint64_t> sum {0};
+            ParallelFor(entries.size(), readThreads, [&](size_t i) { sum += checksum(vfs.getData(entries[i])); });
+            return sum;
+        };
+    };
+
+    size_t reads = 0, batches = 0;
+    auto loaderRead = [&](int readThreads) {
+        return [&, readThreads](const WdfVfs &vfs) -> uint64_t {
+            std::atomic<uint64_t> sum {0};
+            WdfLoader loader(readThreads);
+            for (const auto &entry: vfs.entries())
+                loader.spawn(checksumEntry(loader, vfs, entry, sum));
+            loader.wait();
+            reads = loader.readCount();
+            batches = loader.batchCount();
+            return sum;
+        };
+    };
+
+    printf("entries    %zu, %.2f MB in %zu archives\n", entryCount, toMB(bytes), paths.size());
+    // 以第一次运行的校验和为准
+    bool match = true, first = true;
+    uint64_t expect = 0;
+    auto report = [&](const char *name, int readThreads, double seconds, uint64_t sum, bool loader) {
+        if (first)
+            expect = sum;
+        first = false;
+        match = match && sum == expect;
+        printf("%-10s %d thread%s %.2f ms, %.1f MB/s", name, readThreads, readThreads > 1 ? "s" : "", seconds * 1e3,
+               toMB(bytes) / seconds);
+        if (loader)
+            printf(", %zu reads in %zu batches", reads, batches);
+        printf("\n");
+    };
+
+    for (int readThreads: {1, threads}) {
+        uint64_t sum;
+        double seconds = run(syncRead(readThreads), sum);
+        report("sync", readThreads, seconds, sum, false);
+        seconds = run(loaderRead(readThreads), sum);
+        report("loader", readThreads, seconds, sum, true);
+        if (threads == 1)
+            break;
+    }
+    printf("cache      %s\n", cold ? "dropped before each run" : "not dropped (unsupported)");
+    printf("checksum   %s\n", match ? "match" : "MISMATCH");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+#include "xy2/lineofsight.h"
+#include "xy2/mapx.h"
+#include "xy2/walkgrid.h"
+
+// 随机线段（长度不超过 range 个 Cell），对比逐格走 uint32 Cell 与位图扫描
+int losBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long queries = argInt(args, 0, 4000000);
+    int range = argInt(args, 1, 32);
+    int threads = argInt(args, 2, 0);
+
+    MapX map(mapPath, 0);
+    int cols = map.GetCellColCount(), rows = map.GetCellRowCount();
+    if (cols <= 0)
+        return 1;
+    const uint32_t *cells = map.GetCell();
+
+    Timer buildTimer;
+    LineOfSight los(cells, cols, rows);
+    double buildSeconds = buildTimer.seconds();
+
+    // 两端都取可走格，与单位站位一致
+    std::mt19937 rng(1);
+    auto walkable = [&](int x, int y) { return !WalkGrid::IsBlockedCell(cells[y * cols + x]); };
+    std::vector<LineOfSight::Segment> segments(queries);
+    for (auto &segment: segments) {
+        do {
+            segment.From = {(int) (rng() % cols), (int) (rng() % rows)};
+            segment.To = {std::clamp(segment.From.X + (int) (rng() % (2 * range + 1)) - range, 0, cols - 1),
+                          std::clamp(segment.From.Y + (int) (rng() % (2 * range + 1)) - range, 0, rows - 1)};
+        } while (!walkable(segment.From.X, segment.From.Y) || !walkable(segment.To.X, segment.To.Y));
+    }
+
+    // 参照：按相同的光栅化规则用误差累加逐格读取 Cell
+    auto naiveVisible = [&](LineOfSight::Point a, LineOfSight::Point b) {
+        int dx = b.X - a.X, dy = b.Y - a.Y;
+        if (std::abs(dx) >= std::abs(dy) ? dx < 0 : dy < 0) {
+            std::swap(a, b);
+            dx = -dx;
+            dy = -dy;
+        }
+        int adx = std::abs(dx), ady = std::abs(dy);
+        int major = std::max(adx, ady), minor = std::min(adx, ady);
+        int sx = (dx > 0) - (dx < 0), sy = (dy > 0) - (dy < 0);
+        int x = a.X, y = a.Y, error = major;
+        for (int t = 0; t <= major; t++) {
+            if (WalkGrid::IsBlockedCell(cells[y * cols + x]))
+                return false;
+            error += 2 * minor;
+            bool minorStep = error >= 2 * major;
+            if (minorStep)
+                error -= 2 * major;
+            if (adx >= ady) {
+                x += sx;
+                y += minorStep ? sy : 0;
+            } else {
+                y += sy;
+                x += minorStep ? sx : 0;
+            }
+        }
+        return true;
+    };
+
+    std::vector<uint8_t> naive(queries), single(queries), batch(queries);
+    Timer naiveTimer;
+    for (long long i = 0; i < queries; i++)
+        naive[i] = naiveVisible(segments[i].From, segments[i].To);
+    double naiveSeconds = naiveTimer.seconds();
+
+    Timer singleTimer;
+    for (long long i = 0; i < queries; i++)
+        single[i] = los.Visible(segments[i].From, segments[i].To);
+    double singleSeconds = singleTimer.seconds();
+
+    Timer batchTimer;
+    los.VisibleBatch(segments, batch, threads);
+    double batchSeconds = batchTimer.seconds();
+
+    std::vector<LineOfSight::RayHit> hits(queries);
+    Timer rayTimer;
+    los.RaycastBatch(segments, hits, threads);
+    double raySeconds = rayTimer.seconds();
+
+    long long mismatch = 0, visible = 0;
+    for (long long i = 0; i < queries; i++) {
+        mismatch += naive[i] != single[i] || single[i] != batch[i];
+        visible += single[i];
+    }
+
+    printf("map        %d x %d cells, bitsets %.2f MB, built in %.3f s\n", cols, rows, toMB(los.MemoryBytes()),
+           buildSeconds);
+    printf("queries    %lld, range %d, %.1f%% visible, %lld mismatches\n", queries, range,
+           100.0 * visible / queries, mismatch);
+    printf("naive      %.2f M/s\n", queries / naiveSeconds / 1e6);
+    printf("visible    %.2f M/s\n", queries / singleSeconds / 1e6);
+    printf("batch      %.2f M/s\n", queries / batchSeconds / 1e6);
+    printf("raycast    %.2f M/s\n", queries / raySeconds / 1e6);
+    return mismatch ? 1 : 0;
+}
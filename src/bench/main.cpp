@@ -0,0 +1,58 @@
+#include "bench.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct Command {
+    const char *name;
+    const char *usage;
+    int (*run)(const std::string &, const std::vector<std::string> &);
+};
+
+const Command COMMANDS[] = {
+    {"path", "path <map> [queries=20000] [threads=0] [samples=200]", pathBench},
+    {"los", "los <map> [queries=4000000] [range=32] [threads=0]", losBench},
+    {"flow", "flow <map> [agents=100000] [threads=0]", flowBench},
+    {"stress", "stress <map> [agents=100000] [ticks=50] [threads=0]", stressBench},
+    {"hash", "hash <names.lst> [archive.wdf] [threads=0]", hashBench},
+    {"vfs", "vfs <dir> [lookups=10000000] [threads=0]", vfsBench},
+    {"load", "load <dir> [threads=0]", loadBench},
+    {"was", "was <dir> [threads=0]", wasBench},
+    {"query", "query <map> [queries=200000] [size=800]", queryBench},
+    {"occlusion", "occlusion <map> [queries=200000] [direction=0] [threads=0]", occlusionBench},
+};
+
+bool dropPageCache(const std::vector<std::string> &paths)
+{
+#ifdef _WIN32
+    return false;
+#else
+    for (const auto &path: paths) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return true;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3) {
+        for (const auto &command: COMMANDS) {
+            if (strcmp(argv[1], command.name) == 0)
+                return command.run(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+    }
+    printf("usage: XYBench <command> <file> [args...]\n");
+    for (const auto &command: COMMANDS)
+        printf("  %s\n", command.usage);
+    return 1;
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+
+#include "xy2/mapx.h"
+
+// 随机精灵批量查询遮挡，与逐像素读取遮罩 Alpha 平面的结果对比；direction 为地图扫描方向
+int occlusionBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long queries = argInt(args, 0, 200000);
+    int direction = argInt(args, 1, 0);
+    int threads = argInt(args, 2, 0);
+
+    MapX map(mapPath, direction);
+    int width = map.GetWidth(), height = map.GetHeight();
+    int maskCount = map.GetMaskCount();
+    if (width <= 0 || height <= 0)
+        return 1;
+
+    // Alpha 平面按纹理行序存放，direction 为 1 时行倒序；建立遮挡信息前的基线由 Alpha 平面求出（与渲染端相同）
+    std::vector<const uint8_t *> planes(maskCount);
+    std::vector<int> baseLines(maskCount), lazyBaseLines(maskCount);
+    for (int i = 0; i < maskCount; i++) {
+        map.ReadMaskAlpha(i);
+        planes[i] = map.GetMaskAlpha(i);
+        lazyBaseLines[i] = map.GetMaskBaseLine(i);
+    }
+
+    Timer buildTimer;
+    map.BuildOcclusion(threads);
+    double buildSeconds = buildTimer.seconds();
+    auto covers = [&](int index, int x, int y) {
+        const MapX::MaskInfo *mask = map.GetMaskInfo(index);
+        int col = x - mask->StartX, row = y - mask->StartY;
+        if (col < 0 || row < 0 || col >= (int) mask->Width || row >= (int) mask->Height)
+            return false;
+        if (direction == 1)
+            row = mask->Height - 1 - row;
+        return planes[index][row * mask->Width + col] > 1;
+    };
+
+    // 逐像素对比 MaskCovers，同时求基线（最下一行遮挡像素之下）
+    long long pixelMismatch = 0, coveredPixels = 0, baseLineMismatch = 0;
+    for (int i = 0; i < maskCount; i++) {
+        const MapX::MaskInfo *mask = map.GetMaskInfo(i);
+        baseLines[i] = mask->StartY;
+        for (int y = mask->StartY; y < mask->StartY + (int) mask->Height; y++) {
+            for (int x = mask->StartX; x < mask->StartX + (int) mask->Width; x++) {
+                bool expect = covers(i, x, y);
+                pixelMismatch += expect != map.MaskCovers(i, x, y);
+                coveredPixels += expect;
+                if (expect)
+                    baseLines[i] = y + 1;
+            }
+        }
+        baseLineMismatch += baseLines[i] != lazyBaseLines[i] || baseLines[i] != map.GetMaskBaseLine(i);
+    }
+
+    std::mt19937 rng(1);
+    std::vector<MapX::OcclusionQuery> sprites(queries);
+    for (auto &sprite: sprites) {
+        sprite.HalfWidth = 10 + rng() % 30;
+        sprite.Height = 40 + rng() % 80;
+        sprite.X = rng() % width;
+        sprite.Y = sprite.Height + rng() % (height - sprite.Height);
+    }
+
+    std::vector<uint32_t> offsets;
+    std::vector<int> masks;
+    Timer batchTimer;
+    map.QueryOccluders(sprites, offsets, masks);
+    double batchSeconds = batchTimer.seconds();
+
+    // 参照：遍历全部遮罩，基线在脚下之下且精灵范围内有遮挡像素
+    std::vector<int> expect;
+    long long queryMismatch = 0, occluded = 0;
+    Timer naiveTimer;
+    for (long long q = 0; q < queries; q++) {
+        const auto &sprite = sprites[q];
+        int left = sprite.X - sprite.HalfWidth, top = sprite.Y - sprite.Height;
+        int right = sprite.X + sprite.HalfWidth, bottom = sprite.Y;
+        expect.clear();
+        for (int i = 0; i < maskCount; i++) {
+            const MapX::MaskInfo *mask = map.GetMaskInfo(i);
+            if (baseLines[i] <= sprite.Y)
+                continue;
+            int x0 = std::max(left, mask->StartX), x1 = std::min(right, mask->StartX + (int) mask->Width);
+            int y0 = std::max(top, mask->StartY), y1 = std::min(bottom, mask->StartY + (int) mask->Height);
+            bool hit = false;
+            for (int y = y0; y < y1 && !hit; y++)
+                for (int x = x0; x < x1 && !hit; x++)
+                    hit = covers(i, x, y);
+            if (hit)
+                expect.push_back(i);
+        }
+        std::vector<int> got(masks.begin() + offsets[q], masks.begin() + offsets[q + 1]);
+        std::sort(got.begin(), got.end());
+        queryMismatch += got != expect;
+        occluded += !expect.empty();
+    }
+    double naiveSeconds = naiveTimer.seconds();
+
+    printf("map        %d x %d px, %d masks, direction %d\n", width, height, maskCount, direction);
+    printf("occlusion  %.2f MB, built in %.3f s\n", toMB(map.OcclusionMemoryBytes()), buildSeconds);
+    printf("pixels     %lld covered, %lld mismatches\n", coveredPixels, pixelMismatch);
+    printf("baselines  %lld mismatches\n", baseLineMismatch);
+    printf("queries    %lld, %.1f%% occluded, %lld mismatches\n", queries, 100.0 * occluded / queries, queryMismatch);
+    printf("naive      %.2f M/s\n", queries / naiveSeconds / 1e6);
+    printf("batch      %.2f M/s\n", queries / batchSeconds / 1e6);
+    return pixelMismatch || baseLineMismatch || queryMismatch ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <thread>
+
+#include "xy2/mapx.h"
+#include "xy2/pathfinder.h"
+
+namespace {
+    const double SQRT2 = std::sqrt(2.0);
+
+    // 路径首尾正确、相邻两格 8 邻接且可走、斜行不穿角，返回路径代价，无效时返回负数
+    double pathCost(const PathFinder &finder, PathFinder::Point start, PathFinder::Point goal,
+                    const std::vector<PathFinder::Point> &path)
+    {
+        if (path.empty() || !(path.front() == start) || !(path.back() == goal))
+            return -1.0;
+        double cost = 0.0;
+        for (size_t i = 0; i < path.size(); i++) {
+            if (!finder.IsWalkable(path[i].X, path[i].Y))
+                return -1.0;
+            if (i == 0)
+                continue;
+            int dx = path[i].X - path[i - 1].X, dy = path[i].Y - path[i - 1].Y;
+            if (std::abs(dx) > 1 || std::abs(dy) > 1 || (dx == 0 && dy == 0))
+                return -1.0;
+            if (dx && dy) {
+                if (!finder.IsWalkable(path[i - 1].X + dx, path[i - 1].Y) ||
+                    !finder.IsWalkable(path[i - 1].X, path[i - 1].Y + dy))
+                    return -1.0;
+                cost += SQRT2;
+            } else {
+                cost += 1.0;
+            }
+        }
+        return cost;
+    }
+
+    // 参照：整张网格上的普通 A*，规则与 PathFinder 相同，返回最短代价，不可达时返回负数
+    double gridAStar(const PathFinder &finder, PathFinder::Point start, PathFinder::Point goal)
+    {
+        int cols = finder.GetCols(), rows = finder.GetRows();
+        auto heuristic = [&](int x, int y) {
+            int dx = std::abs(x - goal.X), dy = std::abs(y - goal.Y);
+            return std::max(dx, dy) + (SQRT2 - 1.0) * std::min(dx, dy);
+        };
+        std::vector<double> dist((size_t) cols * rows, INFINITY);
+        std::vector<uint8_t> closed((size_t) cols * rows, 0);
+        using Item = std::pair<double, int>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<>> open;
+        dist[start.Y * cols + start.X] = 0.0;
+        open.push({heuristic(start.X, start.Y), start.Y * cols + start.X});
+        while (!open.empty()) {
+            int index = open.top().second;
+            open.pop();
+            if (closed[index])
+                continue;
+            closed[index] = 1;
+            int x = index % cols, y = index / cols;
+            if (x == goal.X && y == goal.Y)
+                return dist[index];
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx, ny = y + dy;
+                    if ((dx == 0 && dy == 0) || !finder.IsWalkable(nx, ny))
+                        continue;
+                    if (dx && dy && (!finder.IsWalkable(x + dx, y) || !finder.IsWalkable(x, y + dy)))
+                        continue;
+                    double next = dist[index] + (dx && dy ? SQRT2 : 1.0);
+                    if (next < dist[ny * cols + nx]) {
+                        dist[ny * cols + nx] = next;
+                        open.push({next + heuristic(nx, ny), ny * cols + nx});
+                    }
+                }
+            }
+        }
+        return -1.0;
+    }
+}
+
+// 随机可走的起点/终点对，多线程并发查询，统计每秒路径数与内存；
+// 随后逐条校验路径有效性，并抽样与整网格 A* 比较代价
+int pathBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long queries = argInt(args, 0, 20000);
+    int threads = argInt(args, 1, 0);
+    long long samples = argInt(args, 2, 200);
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    MapX map(mapPath, 0);
+    if (map.GetCellColCount() <= 0)
+        return 1;
+
+    Timer buildTimer;
+    PathFinder finder(map.GetCell(), map.GetCellColCount(), map.GetCellRowCount());
+    double buildSeconds = buildTimer.seconds();
+
+    std::vector<std::pair<PathFinder::Point, PathFinder::Point>> pairs;
+    std::mt19937 rng(1);
+    auto randomWalkable = [&]() {
+        for (;;) {
+            PathFinder::Point p{(int) (rng() % finder.GetCols()), (int) (rng() % finder.GetRows())};
+            if (finder.IsWalkable(p.X, p.Y))
+                return p;
+        }
+    };
+    for (long long i = 0; i < queries; i++)
+        pairs.push_back({randomWalkable(), randomWalkable()});
+
+    std::atomic<long long> found{0}, cells{0};
+    Timer queryTimer;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::vector<PathFinder::Point> path;
+            long long localFound = 0, localCells = 0;
+            for (size_t i = t; i < pairs.size(); i += threads) {
+                if (finder.Find(pairs[i].first, pairs[i].second, path)) {
+                    localFound++;
+                    localCells += path.size();
+                }
+            }
+            found += localFound;
+            cells += localCells;
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    double querySeconds = queryTimer.seconds();
+
+    printf("map        %d x %d cells\n", finder.GetCols(), finder.GetRows());
+    printf("graph      %zu nodes, %zu edges, built in %.3f s\n", finder.GetNodeCount(), finder.GetEdgeCount(),
+           buildSeconds);
+    printf("memory     %.2f MB (cells as uint32: %.2f MB)\n", toMB(finder.MemoryBytes()),
+           toMB((size_t) finder.GetCols() * finder.GetRows() * sizeof(uint32_t)));
+    printf("queries    %lld on %d threads, %lld found, avg %.1f cells\n", queries, threads, found.load(),
+           found ? (double) cells / found : 0.0);
+    printf("throughput %.0f paths/s\n", queries / querySeconds);
+
+    long long invalid = 0, reachMismatch = 0, costMismatch = 0, compared = 0;
+    double worstRatio = 1.0, totalRatio = 0.0;
+    long long stride = samples > 0 ? std::max<long long>(1, queries / samples) : 0;
+    std::vector<PathFinder::Point> path;
+    for (long long i = 0; i < queries; i++) {
+        auto [start, goal] = pairs[i];
+        bool ok = finder.Find(start, goal, path);
+        double cost = ok ? pathCost(finder, start, goal, path) : -1.0;
+        invalid += ok && cost < 0.0;
+        if (!stride || i % stride)
+            continue;
+
+        // HPA* 不保证最优，代价只统计偏差；可达性必须一致
+        double best = gridAStar(finder, start, goal);
+        reachMismatch += ok != (best >= 0.0);
+        if (ok && cost >= 0.0 && best >= 0.0) {
+            double ratio = best > 0.0 ? cost / best : 1.0;
+            compared++;
+            costMismatch += cost > best + 1e-3;
+            totalRatio += ratio;
+            worstRatio = std::max(worstRatio, ratio);
+        }
+    }
+    printf("validity   %lld invalid paths\n", invalid);
+    printf("vs A*      %lld sampled, %lld reachability mismatches, %lld longer (avg %.4f, worst %.4f)\n", compared,
+           reachMismatch, costMismatch, compared ? totalRatio / compared : 1.0, worstRatio);
+    return invalid || reachMismatch ? 1 : 0;
+}
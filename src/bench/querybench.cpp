@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+
+#include "xy2/mapx.h"
+
+// 随机矩形（可越出地图边界），对比网格索引的 QueryMasks / QueryMasksAt / QueryCells 与逐个扫描
+int queryBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long queries = argInt(args, 0, 200000);
+    int size = argInt(args, 1, 800);
+
+    MapX map(mapPath, 0);
+    int width = map.GetWidth(), height = map.GetHeight();
+    int cols = map.GetCellColCount(), rows = map.GetCellRowCount();
+    int maskCount = map.GetMaskCount();
+    // 遮罩网格覆盖整数个图块，可能略大于地图尺寸
+    int gridWidth = map.GetColCount() * map.GetBlockWidth(), gridHeight = map.GetRowCount() * map.GetBlockHeight();
+    if (width <= 0 || height <= 0)
+        return 1;
+    const uint32_t *cells = map.GetCell();
+
+    struct Rect {
+        int Left, Top, Right, Bottom;
+    };
+    std::mt19937 rng(1);
+    std::vector<Rect> rects(queries);
+    for (auto &rect: rects) {
+        rect.Left = (int) (rng() % (width + 2 * size)) - size;
+        rect.Top = (int) (rng() % (height + 2 * size)) - size;
+        rect.Right = rect.Left + (int) (rng() % size) + 1;
+        rect.Bottom = rect.Top + (int) (rng() % size) + 1;
+    }
+
+    auto naiveMasks = [&](const Rect &rect, std::vector<int> &out) {
+        out.clear();
+        for (int i = 0; i < maskCount; i++) {
+            const MapX::MaskInfo *mask = map.GetMaskInfo(i);
+            if (std::max(rect.Left, std::max(mask->StartX, 0)) < std::min(rect.Right, std::min(mask->StartX + (int) mask->Width, gridWidth)) &&
+                std::max(rect.Top, std::max(mask->StartY, 0)) < std::min(rect.Bottom, std::min(mask->StartY + (int) mask->Height, gridHeight)))
+                out.push_back(i);
+        }
+    };
+
+    // Cell 为 20x20 像素，与矩形相交即输出
+    auto naiveCells = [&](const Rect &rect, std::vector<uint32_t> &out) {
+        out.clear();
+        for (int row = 0; row < rows; row++) {
+            if (row * 20 >= rect.Bottom || row * 20 + 20 <= rect.Top)
+                continue;
+            for (int col = 0; col < cols; col++) {
+                if (col * 20 < rect.Right && col * 20 + 20 > rect.Left)
+                    out.push_back(cells[row * cols + col]);
+            }
+        }
+    };
+
+    long long maskMismatch = 0, pointMismatch = 0, cellMismatch = 0, found = 0;
+    std::vector<int> masks, expectMasks;
+    std::vector<uint32_t> cellsOut, expectCells;
+
+    Timer maskTimer;
+    for (const auto &rect: rects) {
+        map.QueryMasks(rect.Left, rect.Top, rect.Right, rect.Bottom, masks);
+        found += masks.size();
+    }
+    double maskSeconds = maskTimer.seconds();
+
+    Timer naiveTimer;
+    for (const auto &rect: rects)
+        naiveMasks(rect, expectMasks);
+    double naiveSeconds = naiveTimer.seconds();
+
+    for (const auto &rect: rects) {
+        map.QueryMasks(rect.Left, rect.Top, rect.Right, rect.Bottom, masks);
+        naiveMasks(rect, expectMasks);
+        std::sort(masks.begin(), masks.end());
+        maskMismatch += masks != expectMasks;
+
+        map.QueryMasksAt(rect.Left, rect.Top, masks);
+        naiveMasks({rect.Left, rect.Top, rect.Left + 1, rect.Top + 1}, expectMasks);
+        std::sort(masks.begin(), masks.end());
+        pointMismatch += masks != expectMasks;
+
+        map.QueryCells(rect.Left, rect.Top, rect.Right, rect.Bottom, cellsOut);
+        naiveCells(rect, expectCells);
+        cellMismatch += cellsOut != expectCells;
+    }
+
+    printf("map        %d x %d px, %d masks, %d x %d cells\n", width, height, maskCount, cols, rows);
+    printf("queries    %lld, size <= %d, %.2f masks/query\n", queries, size, (double) found / queries);
+    printf("mismatch   masks %lld, at %lld, cells %lld\n", maskMismatch, pointMismatch, cellMismatch);
+    printf("naive      %.2f M/s\n", queries / naiveSeconds / 1e6);
+    printf("grid       %.2f M/s\n", queries / maskSeconds / 1e6);
+    return maskMismatch || pointMismatch || cellMismatch ? 1 : 0;
+}
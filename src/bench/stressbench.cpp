@@ -0,0 +1,139 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "xy2/mapx.h"
+#include "xy2/parallel.h"
+#include "xy2/pathfinder.h"
+
+namespace {
+    const int CELL_SIZE = 20;       // 一个 Cell 对应的地图像素
+    const int WANDER_RANGE = 32;    // 单位在附近 Cell 内游走
+    const int SPRITE_HALF_WIDTH = 20;
+    const int SPRITE_HEIGHT = 80;
+
+    struct Agent {
+        PathFinder::Point Cell;
+        std::vector<PathFinder::Point> Path;
+        size_t Step;
+    };
+}
+
+// N 个单位在 Cell 网格上游走：走完路径后在附近另选终点寻路，每 tick 前进一格并查询遮挡它们的遮罩，
+// N 从 100 增长到 maxAgents，统计 tick 耗时分布与内存。不需要窗口与 GL
+int stressBench(const std::string &mapPath, const std::vector<std::string> &args)
+{
+    long long maxAgents = argInt(args, 0, 100000);
+    int ticks = std::max<int>(argInt(args, 1, 50), 1);
+    int threads = argInt(args, 2, 0);
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    MapX map(mapPath, 0);
+    if (map.GetCellColCount() <= 0)
+        return 1;
+
+    Timer buildTimer;
+    PathFinder finder(map.GetCell(), map.GetCellColCount(), map.GetCellRowCount(), threads);
+    map.BuildOcclusion(threads);
+    double buildSeconds = buildTimer.seconds();
+
+    int cols = finder.GetCols(), rows = finder.GetRows();
+    printf("map        %d x %d cells, %d masks, built in %.3f s\n", cols, rows, map.GetMaskCount(), buildSeconds);
+    printf("memory     pathfinder %.2f MB, occlusion %.2f MB\n", toMB(finder.MemoryBytes()),
+           toMB(map.OcclusionMemoryBytes()));
+    printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "agents", "spawn ms", "ticks/s", "p50 ms", "p95 ms",
+           "p99 ms", "max ms", "repaths", "occluded");
+
+    for (long long count = 100; count <= maxAgents; count *= 10) {
+        std::mt19937 seed(1);
+        std::vector<Agent> agents(count);
+        for (auto &agent: agents) {
+            do {
+                agent.Cell = {(int) (seed() % cols), (int) (seed() % rows)};
+            } while (!finder.IsWalkable(agent.Cell.X, agent.Cell.Y));
+            agent.Step = 0;
+        }
+
+        // 按块分给线程，每块有自己的随机数与查询结果
+        const size_t CHUNK = 256;
+        size_t chunks = (count + CHUNK - 1) / CHUNK;
+        struct ChunkState {
+            std::mt19937 Rng;
+            std::vector<MapX::OcclusionQuery> Queries;
+            std::vector<uint32_t> Offsets;
+            std::vector<int> Masks;
+            long long Repaths;
+            long long Occluded;
+        };
+        std::vector<ChunkState> states(chunks);
+        for (size_t c = 0; c < chunks; c++)
+            states[c].Rng.seed((uint32_t) c + 1);
+
+        // 第 0 个 tick 所有单位同时寻路，单独统计
+        std::vector<double> latencies;
+        double spawnSeconds = 0;
+        long long repaths = 0, occluded = 0;
+        for (int tick = 0; tick <= ticks; tick++) {
+            Timer tickTimer;
+            ParallelFor(chunks, threads, [&](size_t c) {
+                ChunkState &state = states[c];
+                size_t end = std::min<size_t>(count, (c + 1) * CHUNK);
+                state.Queries.clear();
+                for (size_t i = c * CHUNK; i < end; i++) {
+                    Agent &agent = agents[i];
+                    if (agent.Step + 1 >= agent.Path.size()) {
+                        PathFinder::Point goal{
+                            std::clamp(agent.Cell.X + (int) (state.Rng() % (2 * WANDER_RANGE + 1)) - WANDER_RANGE, 0,
+                                       cols - 1),
+                            std::clamp(agent.Cell.Y + (int) (state.Rng() % (2 * WANDER_RANGE + 1)) - WANDER_RANGE, 0,
+                                       rows - 1)};
+                        if (!finder.Find(agent.Cell, goal, agent.Path))
+                            agent.Path.clear();
+                        agent.Step = 0;
+                        state.Repaths++;
+                    }
+                    if (agent.Step + 1 < agent.Path.size())
+                        agent.Cell = agent.Path[++agent.Step];
+
+                    // 脚下取 Cell 中心
+                    state.Queries.push_back({agent.Cell.X * CELL_SIZE + CELL_SIZE / 2,
+                                             agent.Cell.Y * CELL_SIZE + CELL_SIZE / 2, SPRITE_HALF_WIDTH,
+                                             SPRITE_HEIGHT});
+                }
+                map.QueryOccluders(state.Queries, state.Offsets, state.Masks);
+                for (size_t i = 0; i < state.Queries.size(); i++)
+                    state.Occluded += state.Offsets[i + 1] > state.Offsets[i];
+            });
+            if (tick == 0) {
+                spawnSeconds = tickTimer.seconds();
+                for (auto &state: states)
+                    state.Repaths = state.Occluded = 0;
+            }
+            else
+                latencies.push_back(tickTimer.seconds());
+        }
+
+        size_t agentBytes = agents.capacity() * sizeof(Agent);
+        for (const auto &agent: agents)
+            agentBytes += agent.Path.capacity() * sizeof(PathFinder::Point);
+        for (auto &state: states) {
+            repaths += state.Repaths;
+            occluded += state.Occluded;
+            agentBytes += state.Queries.capacity() * sizeof(MapX::OcclusionQuery)
+                          + state.Offsets.capacity() * sizeof(uint32_t) + state.Masks.capacity() * sizeof(int);
+        }
+
+        double total = 0;
+        for (double latency: latencies)
+            total += latency;
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))] * 1e3; };
+        printf("%-8lld %10.2f %10.1f %10.3f %10.3f %10.3f %10.3f %10.1f %9.1f%%  agents %.2f MB\n", count,
+               spawnSeconds * 1e3, ticks / total, percentile(0.5), percentile(0.95), percentile(0.99), latencies.back() * 1e3,
+               (double) repaths / ticks, 100.0 * occluded / ((double) count * ticks), toMB(agentBytes));
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "xy2/wdfvfs.h"
+
+// 挂载目录下全部 wdf（单线程与多线程各一次，每次之前清空页缓存，避免前一次替后一次预热），
+// 统计合并索引的内存与多线程查找吞吐
+int vfsBench(const std::string &dir, const std::vector<std::string> &args)
+{
+    long long lookups = argInt(args, 0, 10000000);
+    int threads = argInt(args, 1, 0);
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    WdfVfs vfs;
+    if (!vfs.mountDirectory(dir, threads))
+        return 1;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < vfs.archiveCount(); i++)
+        paths.push_back(vfs.archive(i).getPath());
+
+    auto coldMount = [&](int mountThreads) {
+        vfs.clear();
+        bool dropped = dropPageCache(paths);
+        vfs.mountDirectory(dir, mountThreads);
+        return dropped;
+    };
+    bool cold = coldMount(1);
+    double serialSeconds = vfs.mountStats().seconds;
+    cold = coldMount(threads) && cold;
+    const auto &stats = vfs.mountStats();
+
+    size_t mapped = 0;
+    for (size_t i = 0; i < vfs.archiveCount(); i++)
+        mapped += vfs.archive(i).getFileSize();
+
+    printf("archives   %zu, %zu entries, %zu unique, %zu overridden\n", stats.archives, stats.entries,
+           vfs.entries().size(), stats.overridden);
+    printf("mount      1 thread %.2f ms, %d threads %.2f ms, %s\n", serialSeconds * 1e3, threads, stats.seconds * 1e3,
+           cold ? "page cache dropped before each" : "page cache not dropped (unsupported)");
+    printf("memory     %.2f MB index (%.2f MB mapped)\n", toMB(vfs.memoryBytes()), toMB(mapped));
+
+    // 一半命中已有条目，一半为随机 hash
+    std::vector<uint32_t> hashes(std::min<long long>(lookups, 1 << 20));
+    std::mt19937 rng(1);
+    for (auto &hash: hashes)
+        hash = (rng() & 1) && !vfs.entries().empty() ? vfs.entries()[rng() % vfs.entries().size()].hash : rng();
+
+    std::atomic<long long> found {0};
+    Timer lookupTimer;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            long long localFound = 0;
+            for (long long i = t; i < lookups; i += threads)
+                localFound += vfs.find(hashes[i % hashes.size()]) != nullptr;
+            found += localFound;
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    double lookupSeconds = lookupTimer.seconds();
+
+    printf("lookups    %lld on %d threads, %.1f%% found, %.1f M/s\n", lookups, threads,
+           100.0 * found / std::max(lookups, 1ll), lookups / lookupSeconds / 1e6);
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "xy2/parallel.h"
+#include "xy2/was.h"
+#include "xy2/wdfvfs.h"
+
+namespace {
+    // 参照：重写前的逐像素 RLE 解码器，Was::frame 的 RGBA 输出须与之逐字节一致。
+    // 与原实现一样写入前后各多一个像素的缓冲，数据前补 1 字节、后补 64 字节 0
+    void referenceFrame(std::span<const uint8_t> data, const std::array<RGBA, 256> &palette, uint32_t width,
+                        uint32_t height, std::vector<RGBA> &out) {
+        const size_t FRAME_HEAD_SIZE = 16;
+        std::vector<uint8_t> scratch(1 + data.size() + 64, 0);
+        uint8_t *buf = scratch.data() + 1;
+        memcpy(buf, data.data(), data.size());
+        const uint8_t *line = buf + FRAME_HEAD_SIZE;
+        std::vector<RGBA> buffer((size_t) width * height + 2);
+        RGBA *pixels = buffer.data() + 1;
+
+        uint32_t pos = 0;
+        for (uint32_t h = 0; h < height; h++) {
+            uint32_t linePixels = 0;
+            bool lineNotOver = true;
+            uint32_t lineOffset;
+            memcpy(&lineOffset, line + h * sizeof(uint32_t), sizeof(uint32_t));
+            const uint8_t *pData = lineOffset < data.size() ? buf + lineOffset : buf + data.size();
+
+            // 每写一个像素前检查本行是否已满，满了则结束本行
+            auto put = [&](const RGBA &color) {
+                if (linePixels <= width) {
+                    pixels[pos++] = color;
+                    linePixels++;
+                } else {
+                    lineNotOver = false;
+                }
+            };
+            while (*pData != 0 && lineNotOver) {
+                uint8_t repeat;
+                RGBA color;
+                switch (*pData >> 6) {
+                    case 0:
+                        if (*pData & 0x20) {
+                            // {001 +5bit Alpha}+{Index}，前一字节为 0xc0 时重复前一个像素
+                            uint8_t level = *pData & 0x1f;
+                            if (*(pData - 1) == 0xc0) {
+                                if (linePixels <= width) {
+                                    pixels[pos] = pixels[(int64_t) pos - 1];
+                                    linePixels++;
+                                    pos++;
+                                    pData += 2;
+                                    break;
+                                }
+                                lineNotOver = false;
+                            }
+                            pData++;
+                            if (linePixels <= width) {
+                                color = palette[*pData];
+                                color.A = (level << 3) | (7 - 1);
+                                put(color);
+                                pData++;
+                            } else {
+                                lineNotOver = false;
+                            }
+                        } else {
+                            // {000 +5bit Times}+{Alpha}+{Index}
+                            repeat = *pData & 0x1f;
+                            uint8_t level = *++pData;
+                            color = palette[*++pData];
+                            color.A = (level << 3) | (7 - 1);
+                            for (int i = 0; i < repeat; i++)
+                                put(color);
+                            pData++;
+                        }
+                        break;
+                    case 1:  // {01 +6bit Times}+{n 个 Index}
+                        repeat = *pData & 0x3f;
+                        pData++;
+                        for (int i = 0; i < repeat; i++) {
+                            if (linePixels <= width) {
+                                put(palette[*pData]);
+                                pData++;
+                            } else {
+                                lineNotOver = false;
+                            }
+                        }
+                        break;
+                    case 2:  // {10 +6bit Times}+{Index}
+                        repeat = *pData & 0x3f;
+                        color = palette[*++pData];
+                        for (int i = 0; i < repeat; i++)
+                            put(color);
+                        pData++;
+                        break;
+                    default:  // {11 +6bit Times} 跳过，0 次表示回退一个像素
+                        repeat = *pData & 0x3f;
+                        if (repeat == 0) {
+                            if (linePixels <= width) {
+                                pos--;
+                                linePixels--;
+                            } else {
+                                lineNotOver = false;
+                            }
+                        } else {
+                            for (int i = 0; i < repeat; i++) {
+                                if (linePixels <= width) {
+                                    pos++;
+                                    linePixels++;
+                                } else {
+                                    lineNotOver = false;
+                                }
+                            }
+                        }
+                        pData++;
+                        break;
+                }
+            }
+            if (*pData == 0 || !lineNotOver)
+                pos += width - linePixels;
+        }
+        out.assign(pixels, pixels + (size_t) width * height);
+    }
+
+    // 各帧数据（含帧头）在条目中的范围，与 Was 的构造一致；不完整时为空
+    std::vector<std::span<const uint8_t>> frameData(std::span<const uint8_t> data, const Was &was) {
+        std::vector<std::span<const uint8_t>> frames(was.directionCount() * was.frameCount());
+        size_t frameBase = 4 + was.header().headSize;
+        const uint8_t *picOffsets = data.data() + frameBase + 512;
+        for (size_t index = 0; index < frames.size(); index++) {
+            uint32_t begin, end = 0;
+            memcpy(&begin, picOffsets + index * sizeof(uint32_t), sizeof(uint32_t));
+            if (index + 1 < frames.size())
+                memcpy(&end, picOffsets + (index + 1) * sizeof(uint32_t), sizeof(uint32_t));
+            size_t frameBegin = frameBase + begin;
+            size_t frameEnd = end > begin ? std::min(frameBase + end, data.size()) : data.size();
+            if (frameBegin + 16 <= frameEnd)
+                frames[index] = data.subspan(frameBegin, frameEnd - frameBegin);
+        }
+        return frames;
+    }
+}
+
+// 解码目录下全部 wdf 中的精灵（PS 类型），数据直接来自映射区域；对比只看第一帧与解码全部帧，
+// RGBA 结果与重写前的参照解码器逐字节核对，并核对精灵图、索引与预乘模式
+int wasBench(const std::string &dir, const std::vector<std::string> &args)
+{
+    int threads = argInt(args, 0, 0);
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    WdfVfs vfs;
+    if (!vfs.mountDirectory(dir, threads))
+        return 1;
+    vfs.sniffAll(threads);
+    std::vector<const WdfVfs::Entry *> sprites;
+    for (const auto &entry: vfs.entries()) {
+        if (vfs.getType(entry) == WT_PS)
+            sprites.push_back(&entry);
+    }
+    if (sprites.empty()) {
+        printf("no sprites in %s\n", dir.c_str());
+        return 1;
+    }
+
+    // 预览：打开后只取第一帧
+    Timer previewTimer;
+    size_t previewDecoded = 0;
+    for (const auto *entry: sprites) {
+        Was was(vfs.getData(*entry));
+        was.frame(0, 0);
+        previewDecoded += was.decodedCount();
+    }
+    double previewSeconds = previewTimer.seconds();
+
+    // 导出：逐帧解码全部帧
+    size_t frames = 0, pixels = 0, invalid = 0;
+    Timer serialTimer;
+    for (const auto *entry: sprites) {
+        Was was(vfs.getData(*entry));
+        invalid += !was.isValid();
+        for (int i = 0; i < was.directionCount(); i++) {
+            for (int j = 0; j < was.frameCount(); j++) {
+                frames++;
+                pixels += was.frame(i, j).pixels.size();
+            }
+        }
+    }
+    double serialSeconds = serialTimer.seconds();
+
+    // 参照解码器：逐帧解码并与 Was::frame 逐字节比较
+    size_t referenceMismatch = 0;
+    double referenceSeconds = 0.0;
+    std::vector<RGBA> expect;
+    for (const auto *entry: sprites) {
+        auto data = vfs.getData(*entry);
+        Was was(data);
+        if (!was.isValid())
+            continue;
+        auto frames = frameData(data, was);
+        for (int i = 0; i < was.directionCount(); i++) {
+            for (int j = 0; j < was.frameCount(); j++) {
+                const Frame &info = was.frameInfo(i, j);
+                auto bytes = frames[i * was.frameCount() + j];
+                Timer referenceTimer;
+                if (info.width && info.height)
+                    referenceFrame(bytes, was.palette(), info.width, info.height, expect);
+                else
+                    expect.clear();
+                referenceSeconds += referenceTimer.seconds();
+                auto pixels = was.frame(i, j).pixels;
+                referenceMismatch += pixels.size() != expect.size()
+                                     || (!expect.empty() && memcmp(pixels.data(), expect.data(),
+                                                                   expect.size() * sizeof(RGBA)) != 0);
+            }
+        }
+    }
+
+    // 索引模式：解码全部帧，再与 RGBA 结果逐像素核对（查调色板后应一致）
+    Timer indexedTimer;
+    for (const auto *entry: sprites) {
+        Was was(vfs.getData(*entry), WPF_INDEXED);
+        for (int i = 0; i < was.directionCount(); i++) {
+            for (int j = 0; j < was.frameCount(); j++)
+                was.frame(i, j);
+        }
+    }
+    double indexedSeconds = indexedTimer.seconds();
+    // 预乘模式：与 RGBA 结果预乘后一致
+    Timer premultipliedTimer;
+    for (const auto *entry: sprites) {
+        Was was(vfs.getData(*entry), WPF_RGBA_PREMULTIPLIED);
+        for (int i = 0; i < was.directionCount(); i++) {
+            for (int j = 0; j < was.frameCount(); j++)
+                was.frame(i, j);
+        }
+    }
+    double premultipliedSeconds = premultipliedTimer.seconds();
+    size_t indexedMismatch = 0, premultipliedMismatch = 0;
+    for (const auto *entry: sprites) {
+        Was rgba(vfs.getData(*entry)), indexed(vfs.getData(*entry), WPF_INDEXED);
+        Was premultiplied(vfs.getData(*entry), WPF_RGBA_PREMULTIPLIED);
+        for (int i = 0; i < rgba.directionCount(); i++) {
+            for (int j = 0; j < rgba.frameCount(); j++) {
+                auto pixels = rgba.frame(i, j).pixels;
+                auto indices = indexed.frame(i, j).indices;
+                auto multiplied = premultiplied.frame(i, j).pixels;
+                for (size_t k = 0; k < pixels.size(); k++) {
+                    RGBA p = pixels[k], q = indexed.palette()[indices[k].I];
+                    q.A = indices[k].A;
+                    indexedMismatch += p.A != q.A || (p.A && (p.R != q.R || p.G != q.G || p.B != q.B));
+                    RGBA m = multiplied[k];
+                    premultipliedMismatch += m.A != p.A || m.R != (p.R * p.A + 127) / 255
+                                             || m.G != (p.G * p.A + 127) / 255 || m.B != (p.B * p.A + 127) / 255;
+                }
+            }
+        }
+    }
+
+    std::atomic<size_t> parallelPixels{0};
+    Timer parallelTimer;
+    ParallelFor(sprites.size(), threads, [&](size_t i) {
+        Was was(vfs.getData(*sprites[i]));
+        size_t count = 0;
+        for (int d = 0; d < was.directionCount(); d++) {
+            for (int f = 0; f < was.frameCount(); f++)
+                count += was.frame(d, f).pixels.size();
+        }
+        parallelPixels.fetch_add(count, std::memory_order_relaxed);
+    });
+    double parallelSeconds = parallelTimer.seconds();
+
+    // 精灵图：逐帧核对，矩形内与图中一致，矩形外全透明
+    size_t sheetPixels = 0, oldSheetPixels = 0, sheetMismatch = 0;
+    Timer sheetTimer;
+    for (const auto *entry: sprites) {
+        Was was(vfs.getData(*entry));
+        SpriteSheet sheet = was.buildSheet();
+        sheetPixels += sheet.pixels.size();
+        const auto &header = was.header();
+        oldSheetPixels += (size_t) header.width * header.frameNum * header.height * header.directionNum * 2;
+        for (int d = 0; d < was.directionCount(); d++) {
+            for (int f = 0; f < was.frameCount(); f++) {
+                const Frame &frame = was.frame(d, f);
+                const SheetFrame &rect = sheet.frames[d * was.frameCount() + f];
+                for (int y = 0; y < (int) frame.height; y++) {
+                    for (int x = 0; x < (int) frame.width; x++) {
+                        RGBA p = frame.pixels[(size_t) y * frame.width + x];
+                        int sx = x - rect.offsetX, sy = y - rect.offsetY;
+                        if (sx >= 0 && sy >= 0 && sx < rect.width && sy < rect.height) {
+                            RGBA q = sheet.pixels[(size_t) (rect.y + sy) * sheet.width + rect.x + sx];
+                            sheetMismatch += memcmp(&p, &q, sizeof(RGBA)) != 0;
+                        } else {
+                            sheetMismatch += p.A != 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    double sheetSeconds = sheetTimer.seconds();
+
+    printf("sprites    %zu (%zu invalid), %zu frames, %.1f M pixels\n", sprites.size(), invalid, frames, pixels / 1e6);
+    printf("preview    %.2f ms, %.0f sprites/s, %zu frames decoded\n", previewSeconds * 1e3,
+           sprites.size() / previewSeconds, previewDecoded);
+    printf("serial     %.2f ms, %.0f sprites/s, %.0f frames/s, %.1f M pixels/s\n", serialSeconds * 1e3,
+           sprites.size() / serialSeconds, frames / serialSeconds, pixels / serialSeconds / 1e6);
+    printf("reference  %.2f ms, %.1f M pixels/s, %zu frames differ\n", referenceSeconds * 1e3,
+           pixels / referenceSeconds / 1e6, referenceMismatch);
+    printf("parallel   %.2f ms, %.0f sprites/s on %d threads\n", parallelSeconds * 1e3,
+           sprites.size() / parallelSeconds, threads);
+    printf("indexed    %.2f ms, %.1f M pixels/s, %.2f MB vs %.2f MB RGBA, %zu mismatches\n", indexedSeconds * 1e3,
+           pixels / indexedSeconds / 1e6, toMB(pixels * sizeof(IndexedPixel)), toMB(pixels * sizeof(RGBA)),
+           indexedMismatch);
+    printf("premul     %.2f ms, %.1f M pixels/s, %zu mismatches\n", premultipliedSeconds * 1e3,
+           pixels / premultipliedSeconds / 1e6, premultipliedMismatch);
+    printf("sheet      %.2f ms, %.2f MB packed (%.2f MB frames, %.2f MB old sheet), %zu mismatches\n",
+           sheetSeconds * 1e3, toMB(sheetPixels * sizeof(RGBA)), toMB(pixels * sizeof(RGBA)),
+           toMB(oldSheetPixels * sizeof(RGBA)), sheetMismatch);
+    return parallelPixels == pixels && referenceMismatch == 0 && sheetMismatch == 0 && indexedMismatch == 0
+           && premultipliedMismatch == 0 ? 0 : 1;
+}
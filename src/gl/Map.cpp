@@ -1,5 +1,6 @@
 #include "Map.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <ext/matrix_transform.hpp>
@@ -40,61 +41,200 @@ const char *TILE_FRAGMENT_CODE = R"(
     }
 )";
 
-const char *POINT_VERTEX_CODE = R"(
+const char *MASK_VERTEX_CODE = R"(
     #version 330 core
 
-    layout (location = 0) in vec3 aPos;
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in vec2 aMaskCoord;
+    layout (location = 2) in vec2 aTileCoord;
+
+    out vec2 vTileCoord;
+    out vec2 vMaskCoord;
 
-    uniform int uPointSize;
     uniform mat4 uMatrix;
 
-    out vec4 vColor;
+    void main()
+    {
+	    gl_Position = uMatrix * vec4(aPos, 0.0, 1.0);
+        vTileCoord = aTileCoord;
+        vMaskCoord = aMaskCoord;
+    }
+)";
+
+const char *MASK_FRAGMENT_CODE = R"(
+    #version 330 core
+
+    out vec4 FragColor;
+
+    in vec2 vTileCoord;
+    in vec2 vMaskCoord;
+
+    uniform sampler2D uTile;
+    uniform sampler2D uMask;
+    uniform float uHighlight;
 
     void main()
     {
-        gl_PointSize = uPointSize;
-	    gl_Position = uMatrix * vec4(aPos.xy, 0.0, 1.0);
+        vec3 color = texture(uTile, vTileCoord).rgb;
+	    FragColor = vec4(mix(color, vec3(1.0, 0.0, 1.0), uHighlight), texture(uMask, vMaskCoord).a);
+    }
+)";
 
-        switch (int(aPos.z)) {
-            case 0:
-                vColor = vec4(1.0, 1.0, 1.0, 1.0); // 白色
-                break;
-            case 1:
-                vColor = vec4(1.0, 0.0, 0.0, 1.0); // 红色
-                break;
-            case 2:
-                vColor = vec4(1.0, 1.0, 0.0, 1.0); // 黄色
-                break;
-            default:
-                vColor = vec4(0.0, 0.0, 0.0, 1.0); // 黑色
-        }
+const char *MASK_POLY_VERTEX_CODE = R"(
+    #version 330 core
+
+    layout (location = 0) in vec2 aPos;
+    layout (location = 2) in vec2 aTileCoord;
+
+    out vec2 vTileCoord;
+
+    uniform mat4 uMatrix;
+
+    void main()
+    {
+	    gl_Position = uMatrix * vec4(aPos, 0.0, 1.0);
+        vTileCoord = aTileCoord;
     }
 )";
 
-const char *POINT_FRAGMENT_CODE = R"(
+// 遮挡像素的 Alpha 恒为 150
+const char *MASK_POLY_FRAGMENT_CODE = R"(
     #version 330 core
 
     out vec4 FragColor;
 
-    in vec4 vColor;
+    in vec2 vTileCoord;
+
+    uniform sampler2D uTile;
+    uniform float uHighlight;
+
+    void main()
+    {
+        vec3 color = texture(uTile, vTileCoord).rgb;
+	    FragColor = vec4(mix(color, vec3(1.0, 0.0, 1.0), uHighlight), 150.0 / 255.0);
+    }
+)";
+
+const char *MASK_DEPTH_VERTEX_CODE = R"(
+    #version 330 core
+
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in vec2 aMaskCoord;
+    layout (location = 3) in float aDepth;
+
+    out vec2 vMaskCoord;
+
+    uniform mat4 uMatrix;
 
     void main()
     {
+	    gl_Position = uMatrix * vec4(aPos, 0.0, 1.0);
+        gl_Position.z = aDepth * gl_Position.w;
+        vMaskCoord = aMaskCoord;
+    }
+)";
 
-	    FragColor = vColor;
+const char *MASK_DEPTH_FRAGMENT_CODE = R"(
+    #version 330 core
+
+    in vec2 vMaskCoord;
+
+    uniform sampler2D uMask;
+
+    void main()
+    {
+        if (texture(uMask, vMaskCoord).a < 0.5)
+            discard;
     }
 )";
 
+// 遮罩图集页边长，单通道
+constexpr int MASK_PAGE_SIZE = 2048;
+
+const char *CELL_VERTEX_CODE = R"(
+    #version 330 core
+
+    layout (location = 0) in vec2 aPos;
+
+    uniform mat4 uMatrix;
+
+    out vec2 vPos;
+
+    void main()
+    {
+	    gl_Position = uMatrix * vec4(aPos, 0.0, 1.0);
+        vPos = vec2(aPos.x, -aPos.y);
+    }
+)";
+
+// 按片元所在的 Cell 查表，只在格子中心 uPointSize 像素见方的范围内着色
+const char *CELL_FRAGMENT_CODE = R"(
+    #version 330 core
+
+    out vec4 FragColor;
+
+    in vec2 vPos;
+
+    uniform usampler2D uCell;
+    uniform float uCellSize;
+    uniform int uPointSize;
+
+    void main()
+    {
+        vec2 offset = abs(fract(vPos / uCellSize) - 0.5) * uCellSize / fwidth(vPos);
+        if (max(offset.x, offset.y) > uPointSize * 0.5)
+            discard;
+
+        switch (texelFetch(uCell, ivec2(vPos / uCellSize), 0).r) {
+            case 0u:
+                FragColor = vec4(1.0, 1.0, 1.0, 1.0); // 白色
+                break;
+            case 1u:
+                FragColor = vec4(1.0, 0.0, 0.0, 1.0); // 红色
+                break;
+            case 2u:
+                FragColor = vec4(1.0, 1.0, 0.0, 1.0); // 黄色
+                break;
+            default:
+                FragColor = vec4(0.0, 0.0, 0.0, 1.0); // 黑色
+        }
+    }
+)";
+
+// Cell 边长，地图像素
+const int CELL_SIZE = 20;
+
 Map::Map(): m_tileShader(&TILE_VERTEX_CODE, &TILE_FRAGMENT_CODE),
-            m_pointShader(&POINT_VERTEX_CODE, &POINT_FRAGMENT_CODE),
+            m_maskShader(&MASK_VERTEX_CODE, &MASK_FRAGMENT_CODE),
+            m_maskDepthShader(&MASK_DEPTH_VERTEX_CODE, &MASK_DEPTH_FRAGMENT_CODE),
+            m_maskPolyShader(&MASK_POLY_VERTEX_CODE, &MASK_POLY_FRAGMENT_CODE),
+            m_cellShader(&CELL_VERTEX_CODE, &CELL_FRAGMENT_CODE),
             m_position(0.f),
             m_scale(1.f),
             m_matrix(1.f) {
     m_uTileMatrixLocation = m_tileShader.getUniformLocation("uMatrix");
     m_uTileTextureLocation = m_tileShader.getUniformLocation("uTexture");
 
-    m_uPointMatrixLocation = m_pointShader.getUniformLocation("uMatrix");
-    m_uPointSizeLocation = m_pointShader.getUniformLocation("uPointSize");
+    m_uMaskMatrixLocation = m_maskShader.getUniformLocation("uMatrix");
+    m_uMaskHighlightLocation = m_maskShader.getUniformLocation("uHighlight");
+    m_maskShader.use();
+    m_maskShader.setUniform("uTile", 0);
+    m_maskShader.setUniform("uMask", 1);
+
+    m_uMaskDepthMatrixLocation = m_maskDepthShader.getUniformLocation("uMatrix");
+    m_maskDepthShader.use();
+    m_maskDepthShader.setUniform("uMask", 1);
+
+    m_uMaskPolyMatrixLocation = m_maskPolyShader.getUniformLocation("uMatrix");
+    m_uMaskPolyHighlightLocation = m_maskPolyShader.getUniformLocation("uHighlight");
+    m_maskPolyShader.use();
+    m_maskPolyShader.setUniform("uTile", 0);
+
+    m_uCellMatrixLocation = m_cellShader.getUniformLocation("uMatrix");
+    m_uCellPointSizeLocation = m_cellShader.getUniformLocation("uPointSize");
+    m_cellShader.use();
+    m_cellShader.setUniform("uCell", 0);
+    m_cellShader.setUniform("uCellSize", (float) CELL_SIZE);
 
     float vertices[] = {
         -0.5f, 0.5f, 0.0f, 0.0f,
@@ -118,13 +258,44 @@ Map::Map(): m_tileShader(&TILE_VERTEX_CODE, &TILE_FRAGMENT_CODE),
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glGenVertexArrays(1, &m_pointVAO);
-    glGenBuffers(1, &m_pointVBO);
-    glBindVertexArray(m_pointVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
+    glGenVertexArrays(1, &m_cellVAO);
+    glGenBuffers(1, &m_cellVBO);
+    glBindVertexArray(m_cellVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_cellVBO);
+    glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec2), nullptr, GL_STREAM_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), 0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenVertexArrays(1, &m_maskVAO);
+    glGenBuffers(1, &m_maskVBO);
+    glBindVertexArray(m_maskVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_maskVBO);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, pos));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, maskCoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, tileCoord));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, depth));
+    glEnableVertexAttribArray(3);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenVertexArrays(1, &m_maskPolyVAO);
+    glGenBuffers(1, &m_maskPolyVBO);
+    glBindVertexArray(m_maskPolyVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_maskPolyVBO);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, pos));
     glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MaskVertex), (void *) offsetof(MaskVertex, tileCoord));
+    glEnableVertexAttribArray(2);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -134,49 +305,47 @@ Map::~Map() {
     clear();
     glDeleteVertexArrays(1, &m_tileVAO);
     glDeleteBuffers(1, &m_tileVBO);
-    glDeleteVertexArrays(1, &m_pointVAO);
-    glDeleteBuffers(1, &m_pointVBO);
+    glDeleteVertexArrays(1, &m_cellVAO);
+    glDeleteBuffers(1, &m_cellVBO);
+    glDeleteVertexArrays(1, &m_maskVAO);
+    glDeleteBuffers(1, &m_maskVBO);
+    glDeleteVertexArrays(1, &m_maskPolyVAO);
+    glDeleteBuffers(1, &m_maskPolyVBO);
 }
 
 void Map::loadMap(const std::string &mapPath) {
     clear();
     m_map = new MapX(mapPath, 0);
 
-    for (int i = 0; i < m_map->GetMaskCount(); i++) {
-        // map.ReadMask(i); // 这个会越界崩溃
-        m_map->ReadMaskOrigin(i);
-
-        auto info = m_map->GetMaskInfo(i);
-
-        unsigned int texture = addTexture(m_map->GetMaskRGBA(i), info->Width, info->Height, 4);
+    // 遮罩在进入视口或预取范围时才解码上传，见 prepareMasks
+    m_masks.resize(m_map->GetMaskCount());
+    m_maskStats = {};
 
-        glm::mat4 mat = glm::mat4(1);
-        mat = translate(mat, {info->StartX + info->Width / 2.f, -info->StartY - info->Height / 2.f, 0});
-        mat = scale(mat, {info->Width, info->Height, 1});
-
-        m_masks.push_back({mat, texture});
-        m_map->EraseMaskRGB(i);
-    }
-
-    std::vector<glm::vec3> vertices(m_map->GetCellColCount() * m_map->GetCellRowCount());
+    // Cell 网格以每格 1 字节的整数纹理上传一次，绘制时按片元查表
+    std::vector<uint8_t> cells(m_map->GetCellColCount() * m_map->GetCellRowCount());
     uint32_t *cell = m_map->GetCell();
-    for (int row = 0; row < m_map->GetCellRowCount(); row++) {
-        for (int col = 0; col < m_map->GetCellColCount(); col++) {
-            vertices[row * m_map->GetCellColCount() + col] = glm::vec3(col * 20 + 10, -row * 20 - 10, *cell);
-            cell++;
-        }
-    }
-    m_pointCount = vertices.size();
-    glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    for (size_t i = 0; i < cells.size(); i++)
+        cells[i] = std::min<uint32_t>(cell[i], 255);
+    glGenTextures(1, &m_cellTexture);
+    glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, m_map->GetCellColCount(), m_map->GetCellRowCount(), 0, GL_RED_INTEGER,
+                 GL_UNSIGNED_BYTE, cells.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
     // 让地图居中
     // setPosition({-m_map->GetWidth() / 2.f, m_map->GetHeight() / 2.f});
 }
 
 void Map::clear() {
-    m_pointCount = 0;
+    if (m_cellTexture) {
+        glDeleteTextures(1, &m_cellTexture);
+        m_cellTexture = 0;
+    }
     if (m_map) {
         delete m_map;
         m_map = nullptr;
@@ -185,10 +354,13 @@ void Map::clear() {
         glDeleteTextures(1, &tile.second.texture);
     }
     m_tiles.clear();
-    for (auto &mask: m_masks) {
-        glDeleteTextures(1, &mask.texture);
+    for (auto &page: m_maskPages) {
+        glDeleteTextures(1, &page.texture);
     }
+    m_maskPages.clear();
     m_masks.clear();
+    m_maskBatch = {};
+    m_maskStats = {};
 }
 
 void Map::setPosition(const glm::vec2 &position) {
@@ -248,19 +420,397 @@ void Map::drawTile(const glm::mat4 &matrix) {
     }
 }
 
+void Map::prepareMasks() {
+    if (m_maskBatch.frameID == Global::frameID)
+        return;
+    m_maskBatch.frameID = Global::frameID;
+    m_maskBatch.colorRanges.clear();
+    m_maskBatch.depthRanges.clear();
+
+    int blockWidth = m_map->GetBlockWidth();
+    int blockHeight = m_map->GetBlockHeight();
+
+    // 视口外扩 maskPrefetchRing 圈图块作为预取范围
+    int left = (int) floor(m_frame.left / blockWidth - maskPrefetchRing) * blockWidth;
+    int top = (int) floor(-m_frame.top / blockHeight - maskPrefetchRing) * blockHeight;
+    int right = (int) ceil(m_frame.right / blockWidth + maskPrefetchRing) * blockWidth;
+    int bottom = (int) ceil(-m_frame.bottom / blockHeight + maskPrefetchRing) * blockHeight;
+
+    std::vector<int> candidates;
+    m_map->QueryMasks(left, top, right, bottom, candidates);
+
+    std::vector<int> visible;
+    int loads = 0;
+    for (int i: candidates) {
+        auto &mask = m_masks[i];
+        if (mask.page >= 0)
+            m_maskPages[mask.page].lastFrame = Global::frameID;
+
+        auto info = m_map->GetMaskInfo(i);
+        bool inView = info->StartX < m_frame.right && info->StartX + (int) info->Width > m_frame.left &&
+                      info->StartY < -m_frame.bottom && info->StartY + (int) info->Height > -m_frame.top;
+        if (inView) {
+            visible.push_back(i);
+            if (mask.page < 0)
+                loadMaskTexture(i);
+        } else if (mask.page < 0 && loads < maskLoadsPerFrame) {
+            loadMaskTexture(i);
+            loads++;
+        }
+    }
+    evictMasks();
+    m_maskStats.visible = visible.size();
+
+    // 所有可见遮罩写入同一个顶点缓冲：
+    // 颜色部分按覆盖的图块拆成四边形，深度部分每个遮罩一个四边形
+    struct Quad {
+        int page;
+        unsigned int tile;
+        int first;
+    };
+    std::vector<Quad> colorQuads;
+    std::vector<Quad> depthQuads;
+    std::vector<MaskVertex> vertices;
+    auto addQuad = [&](std::vector<Quad> &quads, int i, unsigned int tile, glm::vec2 pMin, glm::vec2 pMax,
+                       glm::vec2 tileMin) {
+        auto &mask = m_masks[i];
+        auto info = m_map->GetMaskInfo(i);
+        auto &page = m_maskPages[mask.page];
+        glm::vec2 pageSize(page.packer.width(), page.packer.height());
+        glm::vec2 maskOrigin = glm::vec2(mask.x - info->StartX, mask.y - info->StartY);
+        float depth = Global::occlusionDepth(mask.baseLine);
+        auto vertex = [&](float x, float y) {
+            glm::vec2 p(x, y);
+            return MaskVertex{{x, -y}, (p + maskOrigin) / pageSize,
+                              (p - tileMin) / glm::vec2(blockWidth, blockHeight), depth};
+        };
+        quads.push_back({mask.page, tile, (int) vertices.size()});
+        vertices.push_back(vertex(pMin.x, pMin.y));
+        vertices.push_back(vertex(pMax.x, pMin.y));
+        vertices.push_back(vertex(pMin.x, pMax.y));
+        vertices.push_back(vertex(pMin.x, pMax.y));
+        vertices.push_back(vertex(pMax.x, pMin.y));
+        vertices.push_back(vertex(pMax.x, pMax.y));
+    };
+
+    for (int i: visible) {
+        if (m_masks[i].page < 0)
+            continue;
+        auto info = m_map->GetMaskInfo(i);
+        glm::vec2 maskMin(info->StartX, info->StartY);
+        glm::vec2 maskMax(info->StartX + info->Width, info->StartY + info->Height);
+        addQuad(depthQuads, i, 0, maskMin, maskMax, maskMin);
+
+        int rowEnd = glm::min<int>(info->occupyRowEnd, m_map->GetRowCount() - 1);
+        int colEnd = glm::min<int>(info->occupyColEnd, m_map->GetColCount() - 1);
+        for (int row = info->occupyRowStart; row <= rowEnd; row++) {
+            for (int col = info->occupyColStart; col <= colEnd; col++) {
+                auto it = m_tiles.find(row * m_map->GetColCount() + col);
+                if (it == m_tiles.end() || !it->second.texture)
+                    continue;
+
+                glm::vec2 tileMin(col * blockWidth, row * blockHeight);
+                glm::vec2 pMin = glm::max(maskMin, tileMin);
+                glm::vec2 pMax = glm::min(maskMax, tileMin + glm::vec2(blockWidth, blockHeight));
+                if (pMin.x >= pMax.x || pMin.y >= pMax.y)
+                    continue;
+                addQuad(colorQuads, i, it->second.texture, pMin, pMax, tileMin);
+            }
+        }
+    }
+
+    // 按 (图集页, 图块纹理) 排序后合并为绘制区间
+    std::vector<MaskVertex> sorted;
+    sorted.reserve(vertices.size());
+    auto appendRanges = [&](std::vector<Quad> &quads, std::vector<MaskRange> &ranges) {
+        std::ranges::sort(quads, [](const Quad &a, const Quad &b) {
+            return a.page != b.page ? a.page < b.page : a.tile < b.tile;
+        });
+        for (auto &quad: quads) {
+            if (ranges.empty() || ranges.back().page != quad.page || ranges.back().tile != quad.tile)
+                ranges.push_back({quad.page, quad.tile, (int) sorted.size(), 0});
+            sorted.insert(sorted.end(), vertices.begin() + quad.first, vertices.begin() + quad.first + 6);
+            ranges.back().count += 6;
+        }
+    };
+    appendRanges(colorQuads, m_maskBatch.colorRanges);
+    appendRanges(depthQuads, m_maskBatch.depthRanges);
+    m_maskStats.drawn = depthQuads.size();
+
+    if (!sorted.empty()) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_maskVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(MaskVertex) * sorted.size(), sorted.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
 void Map::drawMask(const glm::mat4 &matrix) {
     if (!m_map)
         return;
     if (Global::frameID != m_frame.frameID)
         updateFrameProp(matrix, Global::frameID);
-    m_tileShader.use();
-    glBindVertexArray(m_tileVAO);
-    for (auto &tile: m_masks) {
-        glBindTexture(GL_TEXTURE_2D, tile.texture);
+    if (maskPolygon) {
+        drawMaskPolygons();
+        return;
+    }
+    prepareMasks();
+
+    m_maskStats.drawCalls = 0;
+    if (m_maskBatch.colorRanges.empty())
+        return;
+
+    m_maskShader.use();
+    glBindVertexArray(m_maskVAO);
+    m_maskShader.setUniform(m_uMaskMatrixLocation, m_frame.matrix);
+    m_maskShader.setUniform(m_uMaskHighlightLocation, maskHighlight ? 0.3f : 0.f);
+
+    for (auto &range: m_maskBatch.colorRanges) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_maskPages[range.page].texture);
         glActiveTexture(GL_TEXTURE0);
-        // m_tileShader.setUniform(m_uTextureLocation, 0);
-        m_tileShader.setUniform(m_uTileMatrixLocation, m_frame.matrix * tile.matrix);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindTexture(GL_TEXTURE_2D, range.tile);
+        glDrawArrays(GL_TRIANGLES, range.first, range.count);
+        m_maskStats.drawCalls++;
+    }
+}
+
+void Map::drawMaskPolygons() {
+    if (!m_map->HasMaskPolygons())
+        m_map->BuildMaskPolygons();
+
+    int blockWidth = m_map->GetBlockWidth();
+    int blockHeight = m_map->GetBlockHeight();
+
+    std::vector<int> visible;
+    m_map->QueryMasks((int) floor(m_frame.left), (int) floor(-m_frame.top), (int) ceil(m_frame.right),
+                      (int) ceil(-m_frame.bottom), visible);
+
+    // 每个遮罩：三角扇 [fanFirst, coverFirst)，随后是按图块拆分的覆盖四边形
+    struct Cover {
+        unsigned int tile;
+        int first;
+    };
+    std::vector<MaskVertex> vertices;
+    std::vector<Cover> covers;
+    std::vector<int> fanFirst, coverFirst;
+    auto points = m_map->GetPolygonPoints();
+    for (int i: visible) {
+        fanFirst.push_back(vertices.size());
+        auto rings = m_map->GetMaskRings(i);
+        for (size_t r = 0; r + 1 < rings.size(); r++) {
+            auto &p0 = points[rings[r]];
+            for (uint32_t k = rings[r] + 1; k + 1 < rings[r + 1]; k++) {
+                vertices.push_back({{p0.X, -p0.Y}, {}, {}, 0.f});
+                vertices.push_back({{points[k].X, -points[k].Y}, {}, {}, 0.f});
+                vertices.push_back({{points[k + 1].X, -points[k + 1].Y}, {}, {}, 0.f});
+            }
+        }
+        coverFirst.push_back(covers.size());
+
+        auto info = m_map->GetMaskInfo(i);
+        glm::vec2 maskMin(info->StartX, info->StartY);
+        glm::vec2 maskMax(info->StartX + info->Width, info->StartY + info->Height);
+        for (int block: m_map->GetMaskBlocks(i)) {
+            auto it = m_tiles.find(block);
+            if (it == m_tiles.end() || !it->second.texture)
+                continue;
+            glm::vec2 tileMin(block % m_map->GetColCount() * blockWidth, block / m_map->GetColCount() * blockHeight);
+            glm::vec2 pMin = glm::max(maskMin, tileMin);
+            glm::vec2 pMax = glm::min(maskMax, tileMin + glm::vec2(blockWidth, blockHeight));
+            if (pMin.x >= pMax.x || pMin.y >= pMax.y)
+                continue;
+            auto vertex = [&](float x, float y) {
+                return MaskVertex{{x, -y}, {}, (glm::vec2(x, y) - tileMin) / glm::vec2(blockWidth, blockHeight), 0.f};
+            };
+            covers.push_back({it->second.texture, (int) vertices.size()});
+            vertices.push_back(vertex(pMin.x, pMin.y));
+            vertices.push_back(vertex(pMax.x, pMin.y));
+            vertices.push_back(vertex(pMin.x, pMax.y));
+            vertices.push_back(vertex(pMin.x, pMax.y));
+            vertices.push_back(vertex(pMax.x, pMin.y));
+            vertices.push_back(vertex(pMax.x, pMax.y));
+        }
+    }
+    fanFirst.push_back(vertices.size());
+    coverFirst.push_back(covers.size());
+
+    m_maskStats.visible = visible.size();
+    m_maskStats.drawn = visible.size();
+    m_maskStats.drawCalls = 0;
+    if (vertices.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_maskPolyVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(MaskVertex) * vertices.size(), vertices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_maskPolyShader.use();
+    glBindVertexArray(m_maskPolyVAO);
+    m_maskPolyShader.setUniform(m_uMaskPolyMatrixLocation, m_frame.matrix);
+    m_maskPolyShader.setUniform(m_uMaskPolyHighlightLocation, maskHighlight ? 0.3f : 0.f);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_STENCIL_TEST);
+    glStencilMask(1);
+    for (size_t m = 0; m < visible.size(); m++) {
+        if (coverFirst[m] == coverFirst[m + 1])
+            continue;
+        int fanCount = covers[coverFirst[m]].first - fanFirst[m];
+        if (fanCount == 0)
+            continue;
+
+        // 奇偶规则：三角扇覆盖奇数次的像素位于多边形内
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glStencilFunc(GL_ALWAYS, 0, 1);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+        glDrawArrays(GL_TRIANGLES, fanFirst[m], fanCount);
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilFunc(GL_NOTEQUAL, 0, 1);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        for (int c = coverFirst[m]; c < coverFirst[m + 1]; c++) {
+            glBindTexture(GL_TEXTURE_2D, covers[c].tile);
+            glDrawArrays(GL_TRIANGLES, covers[c].first, 6);
+        }
+
+        // 覆盖四边形只画在已加载的图块上，需重画三角扇把整个多边形范围的模板清零，供下一个遮罩使用
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glStencilFunc(GL_ALWAYS, 0, 1);
+        glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+        glDrawArrays(GL_TRIANGLES, fanFirst[m], fanCount);
+        m_maskStats.drawCalls += 2 + coverFirst[m + 1] - coverFirst[m];
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_STENCIL_TEST);
+}
+
+void Map::drawMaskDepth(const glm::mat4 &matrix) {
+    if (!m_map)
+        return;
+    if (Global::frameID != m_frame.frameID)
+        updateFrameProp(matrix, Global::frameID);
+    prepareMasks();
+    if (m_maskBatch.depthRanges.empty())
+        return;
+
+    // 只写深度：遮挡像素的深度由遮罩基线决定，见 Global::occlusionDepth
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    m_maskDepthShader.use();
+    glBindVertexArray(m_maskVAO);
+    m_maskDepthShader.setUniform(m_uMaskDepthMatrixLocation, m_frame.matrix);
+    glActiveTexture(GL_TEXTURE1);
+    for (auto &range: m_maskBatch.depthRanges) {
+        glBindTexture(GL_TEXTURE_2D, m_maskPages[range.page].texture);
+        glDrawArrays(GL_TRIANGLES, range.first, range.count);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisable(GL_DEPTH_TEST);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void Map::loadMaskTexture(int index) {
+    m_map->ReadMaskAlpha(index);
+    auto info = m_map->GetMaskInfo(index);
+    auto &mask = m_masks[index];
+
+    // 从最近使用的图集页开始尝试放入，放不下则新建页，超出预算时先淘汰最久未用的页
+    int page = -1;
+    for (int i = m_maskPages.size() - 1; i >= 0 && page < 0; i--) {
+        if (m_maskPages[i].packer.pack(info->Width, info->Height, mask.x, mask.y))
+            page = i;
+    }
+    if (page < 0) {
+        if (m_maskStats.residentBytes + MASK_PAGE_SIZE * MASK_PAGE_SIZE > maskBudget)
+            evictMasks();
+        page = addMaskPage(glm::max<int>(MASK_PAGE_SIZE, info->Width + 1),
+                           glm::max<int>(MASK_PAGE_SIZE, info->Height + 1));
+        m_maskPages[page].packer.pack(info->Width, info->Height, mask.x, mask.y);
+    }
+
+    mask.page = page;
+    m_maskPages[page].masks.push_back(index);
+    m_maskPages[page].lastFrame = Global::frameID;
+
+    glBindTexture(GL_TEXTURE_2D, m_maskPages[page].texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, mask.x, mask.y, info->Width, info->Height, GL_RED, GL_UNSIGNED_BYTE,
+                    m_map->GetMaskAlpha(index));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // 基线与 MapX::QueryOccluders 使用同一规则，在释放 Alpha 平面前求出
+    mask.baseLine = m_map->GetMaskBaseLine(index);
+    m_map->EraseMaskRGB(index);
+
+    m_maskStats.resident++;
+    m_maskStats.loads++;
+}
+
+int Map::addMaskPage(int width, int height) {
+    // 图集页不生成 mipmap，四周留 1 像素空白防止采样串色
+    MaskPage page;
+    page.packer = ShelfPacker(width, height);
+    glGenTextures(1, &page.texture);
+    glBindTexture(GL_TEXTURE_2D, page.texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLint swizzle[] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+    std::vector<uint8_t> zero(width * height, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, zero.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    m_maskPages.push_back(std::move(page));
+    m_maskStats.pages++;
+    m_maskStats.residentBytes += width * height;
+    return m_maskPages.size() - 1;
+}
+
+void Map::evictMaskPage(int page) {
+    auto &p = m_maskPages[page];
+    for (int i: p.masks) {
+        m_masks[i].page = -1;
+        m_maskStats.resident--;
+        m_maskStats.evictions++;
+    }
+    p.masks.clear();
+    p.packer.reset();
+}
+
+void Map::evictMasks() {
+    // 超出预算时按最久未使用的顺序整页淘汰，当帧用到的页不淘汰；空页的纹理同时释放
+    std::vector<int> candidates;
+    for (int i = 0, count = (int) m_maskPages.size(); i < count; i++) {
+        if (m_maskPages[i].lastFrame != Global::frameID)
+            candidates.push_back(i);
+    }
+    std::ranges::sort(candidates, [this](int a, int b) {
+        return m_maskPages[a].lastFrame < m_maskPages[b].lastFrame;
+    });
+
+    for (int i: candidates) {
+        if (m_maskStats.residentBytes <= maskBudget)
+            break;
+        evictMaskPage(i);
+        auto &page = m_maskPages[i];
+        glDeleteTextures(1, &page.texture);
+        page.texture = 0;
+        m_maskStats.pages--;
+        m_maskStats.residentBytes -= page.packer.width() * page.packer.height();
+    }
+
+    std::erase_if(m_maskPages, [](const MaskPage &page) { return page.texture == 0; });
+    for (int i = 0, count = (int) m_maskPages.size(); i < count; i++) {
+        for (int mask: m_maskPages[i].masks)
+            m_masks[mask].page = i;
     }
 }
 
@@ -269,14 +819,28 @@ void Map::drawCell(const glm::mat4 &matrix) {
         return;
     if (Global::frameID != m_frame.frameID)
         updateFrameProp(matrix, Global::frameID);
-    m_pointShader.use();
-    glBindVertexArray(m_pointVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_pointVBO);
-    m_pointShader.setUniform(m_uPointMatrixLocation, m_frame.matrix);
-    m_pointShader.setUniform(m_uPointSizeLocation, pointSize);
-    glEnable(GL_PROGRAM_POINT_SIZE);
-    glDrawArrays(GL_POINTS, 0, m_pointCount);
-    glDisable(GL_PROGRAM_POINT_SIZE);
+    if (!m_cellTexture)
+        return;
+
+    // 只绘制视口与地图的交集
+    float left = glm::max(m_frame.left, 0.f);
+    float right = glm::min(m_frame.right, (float) m_map->GetCellColCount() * CELL_SIZE);
+    float top = glm::min(m_frame.top, 0.f);
+    float bottom = glm::max(m_frame.bottom, -(float) m_map->GetCellRowCount() * CELL_SIZE);
+    if (left >= right || bottom >= top)
+        return;
+    glm::vec2 vertices[] = {{left, top}, {right, top}, {left, bottom}, {right, bottom}};
+
+    m_cellShader.use();
+    glBindVertexArray(m_cellVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_cellVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_cellShader.setUniform(m_uCellMatrixLocation, m_frame.matrix);
+    m_cellShader.setUniform(m_uCellPointSizeLocation, pointSize);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
 unsigned int Map::addTexture(void *buf, int width, int height, int channels) {
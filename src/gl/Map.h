@@ -7,6 +7,7 @@
 
 #include "Shader.h"
 #include "xy2/mapx.h"
+#include "xy2/shelfpack.h"
 
 class MapX;
 
@@ -18,6 +19,46 @@ class Map {
         unsigned int texture;
     };
 
+    struct MaskTexture {
+        int page{-1};      // 所在图集页，-1 表示未加载
+        int x{0};          // 图集内位置
+        int y{0};
+        int baseLine{0};   // 遮挡基线，地图像素 y，见 MapX::GetMaskBaseLine
+    };
+
+    struct MaskPage {
+        unsigned int texture{0};
+        ShelfPacker packer;
+        std::vector<int> masks;
+        int lastFrame{-1};
+    };
+
+    struct MaskVertex {
+        glm::vec2 pos;
+        glm::vec2 maskCoord;
+        glm::vec2 tileCoord;
+        float depth;
+    };
+
+    struct MaskRange {
+        int page;
+        unsigned int tile;
+        int first;
+        int count;
+    };
+
+public:
+    struct MaskStats {
+        int resident{0};
+        int visible{0};
+        int drawn{0};
+        int drawCalls{0};
+        int pages{0};
+        size_t residentBytes{0};
+        int loads{0};
+        int evictions{0};
+    };
+
 public:
     Map();
 
@@ -39,6 +80,14 @@ public:
     int mapBlockWidth() const { return m_map ? m_map->GetBlockWidth() : 0; }
     int mapBlockHeight() const { return m_map ? m_map->GetBlockHeight() : 0; }
 
+    int maskCount() const { return m_map ? m_map->GetMaskCount() : 0; }
+    const MaskStats &maskStats() const { return m_maskStats; }
+
+    // 尚未矢量化时返回 nullptr
+    const MapX::PolygonStats *polygonStats() const {
+        return m_map && m_map->HasMaskPolygons() ? &m_map->GetPolygonStats() : nullptr;
+    }
+
 private:
     void updateFrameProp(const glm::mat4 &matrix, int frameNum) {
         m_frame.matrix = matrix * m_matrix;
@@ -53,28 +102,62 @@ private:
 
     void drawTile(const glm::mat4 &matrix);
 
+    void prepareMasks();
+
     void drawMask(const glm::mat4 &matrix);
 
+    // 矢量遮罩：先以三角扇翻转模板位，再按模板覆盖绘制图块，不需要遮罩纹理
+    void drawMaskPolygons();
+
+    // 将可见遮罩的遮挡区域按基线写入深度缓冲，供精灵遮挡使用
+    void drawMaskDepth(const glm::mat4 &matrix);
+
     void drawCell(const glm::mat4 &matrix);
 
+    void loadMaskTexture(int index);
+
+    int addMaskPage(int width, int height);
+
+    void evictMaskPage(int page);
+
+    void evictMasks();
+
     unsigned int addTexture(void *buf, int width, int height, int channels);
 
 public:
-    int pointSize{2};
+    int pointSize{2};  // Cell 点大小，屏幕像素
+    bool maskHighlight{false};            // 调试用：遮罩混入 30% 品红，默认显示图块原色
+    int maskPrefetchRing{1};              // 视口外预取的图块圈数
+    int maskLoadsPerFrame{8};             // 每帧最多预取的遮罩数量
+    size_t maskBudget{16 * 1024 * 1024};  // 遮罩图集显存预算
+    bool maskPolygon{false};              // 以矢量多边形绘制遮罩，首次开启时解码全部遮罩进行追踪
 
 private:
     Shader m_tileShader;
-    Shader m_pointShader;
+    Shader m_maskShader;
+    Shader m_maskDepthShader;
+    Shader m_maskPolyShader;
+    Shader m_cellShader;
     unsigned int m_tileVAO;
     unsigned int m_tileVBO;
     int m_uTileMatrixLocation;
     int m_uTileTextureLocation;
 
-    unsigned int m_pointVAO;
-    unsigned int m_pointVBO;
-    unsigned int m_pointCount{0};
-    int m_uPointMatrixLocation;
-    int m_uPointSizeLocation;
+    int m_uMaskMatrixLocation;
+    int m_uMaskHighlightLocation;
+    int m_uMaskDepthMatrixLocation;
+    int m_uMaskPolyMatrixLocation;
+    int m_uMaskPolyHighlightLocation;
+    unsigned int m_maskVAO;
+    unsigned int m_maskVBO;
+    unsigned int m_maskPolyVAO;
+    unsigned int m_maskPolyVBO;
+
+    unsigned int m_cellVAO;
+    unsigned int m_cellVBO;
+    unsigned int m_cellTexture{0};  // R8UI，每个 Cell 一个 texel
+    int m_uCellMatrixLocation;
+    int m_uCellPointSizeLocation;
 
     glm::vec2 m_position;
     glm::vec2 m_scale;
@@ -91,7 +174,16 @@ private:
 
     MapX *m_map{nullptr};
     std::map<int, Tile> m_tiles;
-    std::vector<Tile> m_masks;
+    std::vector<MaskTexture> m_masks;
+    std::vector<MaskPage> m_maskPages;
+
+    // 当帧的遮罩顶点缓冲区间，颜色与深度两遍共用
+    struct {
+        int frameID{-1};
+        std::vector<MaskRange> colorRanges;
+        std::vector<MaskRange> depthRanges;
+    } m_maskBatch;
+    MaskStats m_maskStats;
 };
 
 #endif //MAP_H
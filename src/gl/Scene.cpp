@@ -26,7 +26,11 @@ void Scene::drawScene() {
     if (mapCellVisible)
         m_map.drawCell(mat);
 
-    m_shape.draw(mat);
+    if (spriteOcclusion && m_map.maskCount() > 0) {
+        m_map.drawMaskDepth(mat);
+        m_shape.draw(mat, true);
+    } else
+        m_shape.draw(mat);
 }
 
 void Scene::resetCamera() {
@@ -35,6 +35,7 @@ public:
     bool mapTileVisible{true};
     bool mapMaskVisible{false};
     bool mapCellVisible{false};
+    bool spriteOcclusion{true};
 
 private:
     Map m_map;
@@ -1,9 +1,9 @@
 #include "Shape.h"
 
 #include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
-#include <sstream>
 #include <ext/matrix_transform.hpp>
 #include <glad/glad.h>
 
@@ -19,11 +19,14 @@ const char* VERTEX_CODE = R"(
     out vec2 vTexCoord;
 
     uniform mat4 uMatrix;
+    uniform float uDepth;
+    uniform vec4 uTexRect;
 
     void main()
     {
 	    gl_Position = uMatrix * vec4(aPos, 0.0, 1.0);
-	    vTexCoord = aTexCoord;
+	    gl_Position.z = uDepth * gl_Position.w;
+	    vTexCoord = uTexRect.xy + aTexCoord * uTexRect.zw;
     }
 )";
 
@@ -34,11 +37,27 @@ const char* FRAGMENT_CODE = R"(
 
     in vec2 vTexCoord;
 
+    // R 为调色板索引，G 为 alpha
     uniform sampler2D uTexture;
+    // 256 x 1 的调色板
+    uniform sampler2D uPalette;
+
+    vec4 lookup(ivec2 p)
+    {
+	    vec2 s = texelFetch(uTexture, clamp(p, ivec2(0), textureSize(uTexture, 0) - 1), 0).rg;
+	    vec3 color = texelFetch(uPalette, ivec2(int(s.r * 255.0 + 0.5), 0), 0).rgb;
+	    return vec4(color, s.g);
+    }
 
     void main()
     {
-	    FragColor = texture(uTexture, vTexCoord);
+	    // 索引不能插值，先查调色板再做双线性
+	    vec2 p = vTexCoord * vec2(textureSize(uTexture, 0)) - 0.5;
+	    ivec2 i = ivec2(floor(p));
+	    vec2 f = fract(p);
+	    vec4 top = mix(lookup(i), lookup(i + ivec2(1, 0)), f.x);
+	    vec4 bottom = mix(lookup(i + ivec2(0, 1)), lookup(i + ivec2(1, 1)), f.x);
+	    FragColor = mix(top, bottom, f.y);
     }
 )";
 
@@ -74,6 +93,12 @@ Shape::Shape(): m_spriteShader(&VERTEX_CODE, &FRAGMENT_CODE),
 {
     m_uMatrixLocation = m_spriteShader.getUniformLocation("uMatrix");
     m_uTextureLocation = m_spriteShader.getUniformLocation("uTexture");
+    m_uDepthLocation = m_spriteShader.getUniformLocation("uDepth");
+    m_uTexRectLocation = m_spriteShader.getUniformLocation("uTexRect");
+    m_uPaletteLocation = m_spriteShader.getUniformLocation("uPalette");
+    m_spriteShader.use();
+    m_spriteShader.setUniform(m_uTextureLocation, 0);
+    m_spriteShader.setUniform(m_uPaletteLocation, 1);
     m_uLineMatrixLocation = m_lineShader.getUniformLocation("uMatrix");
 
     float vertices[] = {
@@ -125,75 +150,47 @@ Shape::~Shape()
 
 void Shape::loadWdf(const std::string& wdfPath)
 {
-    if (!m_wdf.load(wdfPath))
-        return;
-    m_wasList.clear();
-    for (auto& was : m_wdf.getWasInfos())
-    {
-        std::stringstream ss;
-        switch (was.second.type)
-        {
-        case WT_PS:
-            ss << "[PS] ";
-            break;
-        case WT_PK:
-            ss << "[PK] ";
-            break;
-        case WT_MP3:
-            ss << "[MP3] ";
-            break;
-        case WT_WAVE:
-            ss << "[WAVE] ";
-            break;
-        case WT_FSB4:
-            ss << "[FSB4] ";
-            break;
-        case WT_JPEG:
-            ss << "[JPEG] ";
-            break;
-        case WT_TGA:
-            ss << "[TGA] ";
-            break;
-        case WT_PNG:
-            ss << "[PNG] ";
-            break;
-        case WT_RAR:
-            ss << "[RAR] ";
-            break;
-        default:
-            ss << "[???] ";
-            break;
-        }
-        ss << std::uppercase << std::hex << was.second.hash;
-        m_wasList.emplace_back(ss.str(), was.second.hash);
-    }
-    std::ranges::sort(m_wasList);
+    std::string paths[] = {wdfPath};
+    m_vfs.mount(paths);
+}
+
+void Shape::mountWdfDirectory(const std::string& dir)
+{
+    m_vfs.mountDirectory(dir);
+}
+
+void Shape::loadWdfNames(const std::string& namesPath)
+{
+    m_vfs.loadNames(namesPath);
 }
 
 void Shape::loadWas(uint32_t hash)
 {
-    if (!m_wdf.getWasInfos().contains(hash))
-        return;
-    if (m_wdf.getWasInfos()[hash].type != WT_PS)
+    const WdfVfs::Entry *entry = m_vfs.find(hash);
+    if (!entry || m_vfs.getType(*entry) != WT_PS)
         return;
 
     clear();
 
-    Was was(m_wdf.getPath(), m_wdf.getWasInfos()[hash]);
+    // 解码为调色板索引，颜色在着色器中查表
+    Was was(m_vfs.getData(*entry), WPF_INDEXED);
     for (auto i : was.times())
     {
         std::cout << i << " ";
     }
-    int width = was.header().width * was.header().frameNum;
-    int height = was.header().height * was.header().directionNum;
-    m_sprite.texture = addTexture((void*)was.pixels().data(), width, height, 4);
-    m_sprite.matrix = glm::mat4(1.f);
-    m_sprite.matrix = glm::translate(m_sprite.matrix, {-width / 2, height / 2, 0});
-    m_sprite.matrix = glm::scale(m_sprite.matrix, {width, height, 1.f});
-
+    SpriteSheet sheet = was.buildSheet();
+    if (sheet.width > 0 && sheet.height > 0)
+    {
+        m_texture = addTexture((void*)sheet.indices.data(), sheet.width, sheet.height, 2);
+        m_textureBytes = sheet.indices.size() * sizeof(IndexedPixel);
+    }
+    m_palette = was.palette();
+    m_paletteTexture = addTexture((void*)m_palette.data(), 256, 1, 4);
+    if (m_hue != 0.f)
+        setHue(m_hue);
 
-    const auto& fullFrames = was.fullFrames();
-    m_frameList.resize(fullFrames.size());
+    int directionCount = was.directionCount();
+    m_frameList.resize(directionCount);
 
     struct Pos
     {
@@ -201,7 +198,7 @@ void Shape::loadWas(uint32_t hash)
         float y{0.f};
     };
     Pos ps[10];
-    switch (fullFrames.size())
+    switch (directionCount)
     {
     case 2:
         ps[0].x = -100.f;
@@ -227,23 +224,28 @@ void Shape::loadWas(uint32_t hash)
         break;
     }
 
-    for (int i = 0; i < fullFrames.size(); i++)
+    for (int i = 0; i < directionCount; i++)
     {
-        m_frameList[i].resize(fullFrames[i].size());
+        m_frameList[i].resize(was.frameCount());
 
-        for (int j = 0; j < fullFrames[i].size(); j++)
+        for (int j = 0; j < was.frameCount(); j++)
         {
-            uint32_t texture = addTexture((void*)fullFrames[i][j].pixels.data(), fullFrames[i][j].width,
-                                          fullFrames[i][j].height, 4);
+            // 只画去掉透明边后的矩形，位置按其在帧内的偏移换算
+            const Frame& frame = was.frameInfo(i, j);
+            const SheetFrame& rect = sheet.frames[i * was.frameCount() + j];
             glm::mat4 mat = glm::mat4(1);
-            float x = ((float)fullFrames[i][j].width / 2.f) - fullFrames[i][j].x;
-            float y = -((float)fullFrames[i][j].height / 2.f) + fullFrames[i][j].y;
+            float x = rect.offsetX + (float)rect.width / 2.f - frame.x;
+            float y = frame.y - rect.offsetY - (float)rect.height / 2.f;
             mat = translate(mat, {x + ps[i].x, y + ps[i].y, 0});
-            mat = scale(mat, {fullFrames[i][j].width, fullFrames[i][j].height, 1});
+            mat = scale(mat, {rect.width, rect.height, 1});
 
             glm::mat4 orimat = glm::mat4(1);
             orimat = translate(orimat, {ps[i].x, ps[i].y, 0});
-            m_frameList[i][j] = {orimat, mat, texture};
+            glm::vec4 texRect(0.f);
+            if (rect.width > 0)
+                texRect = {(float)rect.x / sheet.width, (float)rect.y / sheet.height,
+                           (float)rect.width / sheet.width, (float)rect.height / sheet.height};
+            m_frameList[i][j] = {orimat, mat, texRect};
         }
     }
 }
@@ -262,35 +264,69 @@ void Shape::setScale(const glm::vec2& scale)
     m_matrix = glm::scale(m_matrix, glm::vec3(m_scale.x, m_scale.y, 1));
 }
 
-void Shape::clear()
+void Shape::setHue(float degrees)
 {
-    for (auto& frames : m_frameList)
+    m_hue = degrees;
+    if (!m_paletteTexture)
+        return;
+
+    // 绕灰轴旋转 RGB，亮度基本不变
+    float c = std::cos(glm::radians(degrees)), s = std::sin(glm::radians(degrees));
+    float k = (1.f - c) / 3.f, q = s / std::sqrt(3.f);
+    glm::mat3 rotate(c + k, k + q, k - q,
+                     k - q, c + k, k + q,
+                     k + q, k - q, c + k);
+    std::array<RGBA, 256> palette = m_palette;
+    for (auto& color : palette)
     {
-        for (auto& frame : frames)
-        {
-            glDeleteTextures(1, &frame.texture);
-        }
+        glm::vec3 rgb = glm::clamp(rotate * glm::vec3(color.R, color.G, color.B), 0.f, 255.f);
+        color = {(uint8_t)(rgb.r + 0.5f), (uint8_t)(rgb.g + 0.5f), (uint8_t)(rgb.b + 0.5f), color.A};
     }
-    m_frameList.clear();
+    glBindTexture(GL_TEXTURE_2D, m_paletteTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, palette.data());
+}
 
-    // glDeleteTextures(1, &m_spirit.texture);
-    // m_spirit.texture = 0;
+void Shape::clear()
+{
+    m_frameList.clear();
+    glDeleteTextures(1, &m_texture);
+    glDeleteTextures(1, &m_paletteTexture);
+    m_texture = 0;
+    m_paletteTexture = 0;
+    m_textureBytes = 0;
 }
 
-void Shape::draw(const glm::mat4& matrix)
+void Shape::draw(const glm::mat4& matrix, bool occlusion)
 {
     glm::mat4 mat = matrix * m_matrix;
     int f = Global::time / 0.1f;
     for (auto& frames : m_frameList)
     {
         int i = f % frames.size();
+        // 以脚底（原点）所在的地图 y 作为深度，与遮罩基线比较，见 Map::drawMaskDepth；
+        // 脚底与基线相同时不被遮挡，与 MapX::QueryOccluders 一致
+        glm::vec4 feet = m_matrix * frames[i].oriMatrix * glm::vec4(0.f, 0.f, 0.f, 1.f);
+        if (occlusion)
+        {
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
         m_spriteShader.use();
         glBindVertexArray(m_spriteVAO);
-        glBindTexture(GL_TEXTURE_2D, frames[i].texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_paletteTexture);
         glActiveTexture(GL_TEXTURE0);
-        // m_shader.setUniform(m_uTextureLocation, 0);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
         m_spriteShader.setUniform(m_uMatrixLocation, mat * frames[i].matrix);
+        m_spriteShader.setUniform(m_uTexRectLocation, frames[i].texRect);
+        m_spriteShader.setUniform(m_uDepthLocation, Global::occlusionDepth(-feet.y));
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (occlusion)
+        {
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_TRUE);
+        }
 
         m_lineShader.use();
         glBindVertexArray(m_lineVAO);
@@ -308,12 +344,15 @@ uint32_t Shape::addTexture(void* buf, int width, int height, int channels)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // 着色器用 texelFetch 取值后自行插值
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    auto fmt = channels == 4 ? GL_RGBA : GL_RGB;
+    GLenum fmt = channels == 4 ? GL_RGBA : channels == 3 ? GL_RGB : channels == 2 ? GL_RG : GL_RED;
+    GLenum internalFmt = channels == 4 ? GL_RGBA8 : channels == 3 ? GL_RGB8 : channels == 2 ? GL_RG8 : GL_R8;
 
-    glTexImage2D(GL_TEXTURE_2D, 0, fmt, width, height, 0, fmt, GL_UNSIGNED_BYTE, buf);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFmt, width, height, 0, fmt, GL_UNSIGNED_BYTE, buf);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     return texture;
 }
@@ -3,12 +3,14 @@
 #include <vector>
 #include <glm.hpp>
 #include "Shader.h"
-#include "xy2/wdf.h"
+#include "xy2/was.h"
+#include "xy2/wdfvfs.h"
 
 struct ShapeFrame {
     glm::mat4 oriMatrix;
     glm::mat4 matrix;
-    unsigned int texture;
+    // 帧在精灵图纹理中的 uv 矩形：x, y, 宽, 高
+    glm::vec4 texRect;
 };
 
 class Shape {
@@ -19,17 +21,32 @@ public:
 
     void loadWdf(const std::string &wdfPath);
 
+    // 挂载目录下全部 wdf 及补丁
+    void mountWdfDirectory(const std::string &dir);
+
+    // 名称列表文件，每行一个路径
+    void loadWdfNames(const std::string &namesPath);
+
     void loadWas(uint32_t hash);
 
-    const std::vector<std::pair<std::string, uint32_t> > &wasList() { return m_wasList; }
+    const WdfVfs &vfs() const { return m_vfs; }
 
     void setPosition(const glm::vec2 &position);
 
     void setScale(const glm::vec2 &scale);
 
+    // 旋转调色板的色相，只更新调色板纹理，不重新解码
+    void setHue(float degrees);
+
+    float hue() const { return m_hue; }
+
+    // 精灵图纹理的字节数
+    size_t textureBytes() const { return m_textureBytes; }
+
     void clear();
 
-    void draw(const glm::mat4 &matrix);
+    // occlusion 为 true 时按深度缓冲中的遮罩遮挡精灵
+    void draw(const glm::mat4 &matrix, bool occlusion = false);
 
 private:
     uint32_t addTexture(void *buf, int width, int height, int channels);
@@ -45,6 +62,9 @@ private:
 
     int m_uMatrixLocation;
     int m_uTextureLocation;
+    int m_uDepthLocation;
+    int m_uTexRectLocation;
+    int m_uPaletteLocation;
 
     int m_uLineMatrixLocation;
 
@@ -53,10 +73,14 @@ private:
     glm::mat4 m_matrix;
 
     std::vector<std::vector<ShapeFrame>> m_frameList;
-    ShapeFrame m_sprite;
-
-    Wdf m_wdf;
-    std::vector<std::pair<std::string, uint32_t> > m_wasList;
+    // 全部帧共用一张精灵图（RG8：调色板索引与 alpha）
+    unsigned int m_texture{0};
+    size_t m_textureBytes{0};
+    unsigned int m_paletteTexture{0};
+    std::array<RGBA, 256> m_palette;
+    float m_hue{0.f};
+
+    WdfVfs m_vfs;
 };
 
 
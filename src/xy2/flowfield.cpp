@@ -0,0 +1,212 @@
+#include "flowfield.h"
+#include "parallel.h"
+#include "walkgrid.h"
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <thread>
+
+namespace {
+	const int DX[8] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+	const int DY[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+	const uint32_t STEP_COST[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+	// 边代价不超过 14，待处理的代价总落在 (D, D + 14] 内，15 个桶循环使用即可
+	const int BUCKETS = 15;
+
+	// 前沿格数达到此值才分给多个线程
+	const size_t PARALLEL_MIN = 1024;
+
+	// 左闭右开
+	struct Box {
+		int Left;
+		int Top;
+		int Right;
+		int Bottom;
+
+		bool Contains(int x, int y) const { return x >= Left && y >= Top && x < Right && y < Bottom; }
+	};
+
+	struct WaveLocal {
+		std::vector<int> Out[BUCKETS];
+		std::vector<int> Touched;
+	};
+}
+
+FlowField::FlowField(const uint32_t* cells, int cols, int rows)
+	: m_Cols(cols), m_Rows(rows)
+{
+	m_Walkable.resize((size_t)cols * rows);
+	for (size_t i = 0; i < m_Walkable.size(); i++)
+		m_Walkable[i] = !WalkGrid::IsBlockedCell(cells[i]);
+	m_Cost.assign(m_Walkable.size(), UNREACHABLE);
+	m_Direction.assign(m_Walkable.size(), DIR_NONE);
+}
+
+bool FlowField::SetGoal(Point goal, int radius, int threads) {
+	radius = std::max(radius, 0);
+	if (goal.X == m_Goal.X && goal.Y == m_Goal.Y && radius == m_Radius)
+		return false;
+	m_Goal = goal;
+	m_Radius = radius;
+
+	for (int index : m_Touched) {
+		m_Cost[index] = UNREACHABLE;
+		m_Direction[index] = DIR_NONE;
+	}
+	m_Touched.clear();
+	if (!InRange(goal.X, goal.Y) || !m_Walkable[goal.Y * m_Cols + goal.X])
+		return true;
+
+	Box box{ 0, 0, m_Cols, m_Rows };
+	if (radius > 0)
+		box = { std::max(goal.X - radius, 0), std::max(goal.Y - radius, 0), std::min(goal.X + radius + 1, m_Cols), std::min(goal.Y + radius + 1, m_Rows) };
+
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Dial 桶式 Dijkstra：同一桶内的格子代价相同且已确定，互不影响，可分给多个线程同时松弛邻格，
+	// 邻格代价用原子取小更新，改进后放入线程局部的桶，每轮结束时合并
+	int goalIndex = goal.Y * m_Cols + goal.X;
+	m_Cost[goalIndex] = 0;
+	m_Touched.push_back(goalIndex);
+
+	std::vector<int> buckets[BUCKETS];
+	std::vector<int> frontier{ goalIndex };
+	std::vector<WaveLocal> locals(threads);
+	size_t pending = 0;
+	uint32_t distance = 0;
+
+	auto relax = [&](size_t begin, size_t end, WaveLocal& local) {
+		for (size_t i = begin; i < end; i++) {
+			int index = frontier[i];
+			if (std::atomic_ref<uint32_t>(m_Cost[index]).load(std::memory_order_relaxed) != distance)
+				continue;
+			int x = index % m_Cols, y = index / m_Cols;
+			for (int k = 0; k < 8; k++) {
+				int nx = x + DX[k], ny = y + DY[k];
+				if (!box.Contains(nx, ny) || !m_Walkable[ny * m_Cols + nx])
+					continue;
+				if (k >= 4 && !(m_Walkable[y * m_Cols + nx] && m_Walkable[ny * m_Cols + x]))
+					continue;
+
+				int next = ny * m_Cols + nx;
+				uint32_t cost = distance + STEP_COST[k];
+				std::atomic_ref<uint32_t> ref(m_Cost[next]);
+				uint32_t old = ref.load(std::memory_order_relaxed);
+				while (cost < old && !ref.compare_exchange_weak(old, cost, std::memory_order_relaxed)) {
+				}
+				if (cost < old) {
+					if (old == UNREACHABLE)
+						local.Touched.push_back(next);
+					local.Out[cost % BUCKETS].push_back(next);
+				}
+			}
+		}
+	};
+
+	// 合并线程局部结果并取出下一个非空桶，全部处理完时返回 false
+	auto advance = [&]() {
+		for (auto& local : locals) {
+			for (int b = 0; b < BUCKETS; b++) {
+				buckets[b].insert(buckets[b].end(), local.Out[b].begin(), local.Out[b].end());
+				pending += local.Out[b].size();
+				local.Out[b].clear();
+			}
+			m_Touched.insert(m_Touched.end(), local.Touched.begin(), local.Touched.end());
+			local.Touched.clear();
+		}
+		frontier.clear();
+		if (pending == 0)
+			return false;
+		do {
+			distance++;
+		} while (buckets[distance % BUCKETS].empty());
+		frontier.swap(buckets[distance % BUCKETS]);
+		pending -= frontier.size();
+		return true;
+	};
+
+	// 前沿较小时由当前线程直接处理，避免每个桶都唤醒一次工作线程
+	size_t parallelMin = threads > 1 ? PARALLEL_MIN : SIZE_MAX;
+	auto serialSteps = [&]() {
+		while (advance()) {
+			if (frontier.size() >= parallelMin)
+				return true;
+			relax(0, frontier.size(), locals[0]);
+		}
+		return false;
+	};
+
+	relax(0, frontier.size(), locals[0]);
+	if (serialSteps()) {
+		bool done = false;
+		std::barrier sync(threads, [&]() noexcept { done = !serialSteps(); });
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t]() {
+				while (!done) {
+					size_t count = frontier.size();
+					relax(count * t / threads, count * (t + 1) / threads, locals[t]);
+					sync.arrive_and_wait();
+				}
+			});
+		}
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	BuildDirections(threads);
+	return true;
+}
+
+void FlowField::BuildDirections(int threads) {
+	const size_t CHUNK = 4096;
+	ParallelFor((m_Touched.size() + CHUNK - 1) / CHUNK, threads, [&](size_t chunk) {
+		size_t end = std::min(m_Touched.size(), (chunk + 1) * CHUNK);
+		for (size_t i = chunk * CHUNK; i < end; i++) {
+			int index = m_Touched[i];
+			uint32_t cost = m_Cost[index];
+			if (cost == 0) {
+				m_Direction[index] = DIR_GOAL;
+				continue;
+			}
+
+			// 取使 邻格代价 + 步长 等于自身代价的方向，直行优先
+			int x = index % m_Cols, y = index / m_Cols;
+			uint8_t direction = DIR_NONE;
+			for (int k = 0; k < 8 && direction == DIR_NONE; k++) {
+				int nx = x + DX[k], ny = y + DY[k];
+				if (!InRange(nx, ny) || !m_Walkable[ny * m_Cols + nx])
+					continue;
+				if (k >= 4 && !(m_Walkable[y * m_Cols + nx] && m_Walkable[ny * m_Cols + x]))
+					continue;
+				uint32_t next = m_Cost[ny * m_Cols + nx];
+				if (next != UNREACHABLE && next + STEP_COST[k] == cost)
+					direction = (uint8_t)k;
+			}
+			m_Direction[index] = direction;
+		}
+	});
+}
+
+FlowField::Point FlowField::Next(Point p) const {
+	uint8_t direction = GetDirection(p.X, p.Y);
+	if (direction >= 8)
+		return p;
+	return { p.X + DX[direction], p.Y + DY[direction] };
+}
+
+void FlowField::NextBatch(std::span<const Point> agents, std::span<Point> out) const {
+	size_t count = std::min(agents.size(), out.size());
+	for (size_t i = 0; i < count; i++)
+		out[i] = Next(agents[i]);
+}
+
+size_t FlowField::MemoryBytes() const {
+	return m_Walkable.capacity()
+		+ m_Cost.capacity() * sizeof(uint32_t)
+		+ m_Direction.capacity()
+		+ m_Touched.capacity() * sizeof(int);
+}
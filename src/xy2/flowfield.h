@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// 面向人群的流场：对一个目标点在 Cell 网格上求积分场（到目标的最短代价），再由积分场得到每格的前进方向，
+// 大量单位前往同一目标时只需逐格查表。移动规则与 PathFinder 相同：8 方向、斜行不穿角，代价直行 10、斜行 14。
+// 积分场用多线程波前（Dial 桶式 Dijkstra）计算。SetGoal 期间不可查询，其余查询只读，可多线程并发。
+class FlowField {
+public:
+	static constexpr uint32_t UNREACHABLE = 0xffffffff;
+	static constexpr uint8_t DIR_GOAL = 8;      // 已在目标
+	static constexpr uint8_t DIR_NONE = 0xff;   // 不可达或超出范围
+
+	struct Point {
+		int X;  // Cell 列
+		int Y;  // Cell 行
+	};
+
+	// cells 为 MapX::GetCell() 的 Cell 数组
+	FlowField(const uint32_t* cells, int cols, int rows);
+
+	// 以 goal 为目标重建流场。radius > 0 时只计算与目标切比雪夫距离不超过 radius 的区域，
+	// 区域外的格子为 DIR_NONE，其中的单位需另行寻路（如 PathFinder）；radius 为 0 时计算整张地图。
+	// 目标与范围不变时直接返回；目标移动时不做增量修补（几乎所有格子的代价都会改变），而是在区域内完整重算，
+	// 只是清理时仅重置上一次触及的格子，因此耗时与区域大小成正比，radius 为 0 即整图重建。
+	// threads 为 0 时使用硬件线程数。返回本次是否重新计算
+	bool SetGoal(Point goal, int radius = 0, int threads = 0);
+
+	Point GetGoal() const { return m_Goal; }
+
+	// 到目标的代价，UNREACHABLE 表示不可达
+	uint32_t GetCost(int x, int y) const { return InRange(x, y) ? m_Cost[y * m_Cols + x] : UNREACHABLE; }
+
+	// 0-7 依次为 东、南、西、北、东南、西南、西北、东北，或 DIR_GOAL / DIR_NONE
+	uint8_t GetDirection(int x, int y) const { return InRange(x, y) ? m_Direction[y * m_Cols + x] : DIR_NONE; }
+
+	// 沿流场走一步后的格子，目标或不可达时原地不动
+	Point Next(Point p) const;
+
+	// 批量查询，out[i] = Next(agents[i])
+	void NextBatch(std::span<const Point> agents, std::span<Point> out) const;
+
+	int GetCols() const { return m_Cols; }
+	int GetRows() const { return m_Rows; }
+
+	// 本次重建触及的格子数
+	size_t GetTouchedCount() const { return m_Touched.size(); }
+
+	size_t MemoryBytes() const;
+
+private:
+	bool InRange(int x, int y) const { return x >= 0 && y >= 0 && x < m_Cols && y < m_Rows; }
+
+	void BuildDirections(int threads);
+
+	int m_Cols;
+	int m_Rows;
+
+	std::vector<uint8_t> m_Walkable;
+
+	std::vector<uint32_t> m_Cost;  // 积分场
+
+	std::vector<uint8_t> m_Direction;
+
+	std::vector<int> m_Touched;  // 上一次重建写入过代价的格子
+
+	Point m_Goal{ -1, -1 };
+
+	int m_Radius{ -1 };
+};
@@ -0,0 +1,167 @@
+#include "lineofsight.h"
+#include "parallel.h"
+#include "walkgrid.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+namespace {
+	// [a, b] 内最低的置位，没有返回 -1
+	int FirstSetForward(const uint64_t* line, int a, int b) {
+		int w = a >> 6, last = b >> 6;
+		uint64_t word = line[w] & (~0ull << (a & 63));
+		for (;;) {
+			if (w == last)
+				word &= ~0ull >> (63 - (b & 63));
+			if (word)
+				return (w << 6) + std::countr_zero(word);
+			if (w == last)
+				return -1;
+			word = line[++w];
+		}
+	}
+
+	// [a, b] 内最高的置位，没有返回 -1
+	int FirstSetBackward(const uint64_t* line, int a, int b) {
+		int w = b >> 6, last = a >> 6;
+		uint64_t word = line[w] & (~0ull >> (63 - (b & 63)));
+		for (;;) {
+			if (w == last)
+				word &= ~0ull << (a & 63);
+			if (word)
+				return (w << 6) + 63 - std::countl_zero(word);
+			if (w == last)
+				return -1;
+			word = line[--w];
+		}
+	}
+
+	// 批量查询按块分配给线程，避免相邻结果落在不同线程造成伪共享
+	const size_t BATCH_CHUNK = 4096;
+}
+
+LineOfSight::LineOfSight(const uint32_t* cells, int cols, int rows)
+	: m_Cols(cols), m_Rows(rows), m_WordsPerRow((cols + 63) / 64), m_WordsPerCol((rows + 63) / 64) {
+	m_RowBits.assign((size_t)m_WordsPerRow * rows, 0);
+	m_ColBits.assign((size_t)m_WordsPerCol * cols, 0);
+	for (int y = 0; y < rows; y++) {
+		for (int x = 0; x < cols; x++) {
+			if (WalkGrid::IsBlockedCell(cells[y * cols + x])) {
+				m_RowBits[(size_t)y * m_WordsPerRow + (x >> 6)] |= 1ull << (x & 63);
+				m_ColBits[(size_t)x * m_WordsPerCol + (y >> 6)] |= 1ull << (y & 63);
+			}
+		}
+	}
+}
+
+bool LineOfSight::IsBlocked(int x, int y) const {
+	if (!InRange({ x, y }))
+		return true;
+	return (m_RowBits[(size_t)y * m_WordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
+LineOfSight::Point LineOfSight::StepPoint(Point from, int dx, int dy, int t) {
+	int adx = std::abs(dx), ady = std::abs(dy);
+	int sx = (dx > 0) - (dx < 0), sy = (dy > 0) - (dy < 0);
+	if (adx >= ady)
+		return { from.X + sx * t, from.Y + sy * MinorOffset(t, adx, ady) };
+	return { from.X + sx * MinorOffset(t, ady, adx), from.Y + sy * t };
+}
+
+int LineOfSight::Scan(const uint64_t* bits, int wordsPerLine, int u0, int v0, int du, int dv, int tLimit) {
+	int adu = std::abs(du), adv = std::abs(dv);
+	int su = du >= 0 ? 1 : -1, sv = dv >= 0 ? 1 : -1;
+
+	// 副轴第 k 行覆盖主轴步数 [T(k), T(k + 1) - 1]，T(k + 1) = ceil((2k + 1) * |du| / (2 * |dv|))，
+	// 分子每行增加 2 * |du|，商与余数增量计算，避免逐行除法
+	long long denom = 2ll * std::max(adv, 1);
+	long long numer = adu + denom - 1;
+	int tNext = (int)(numer / denom), quotStep = (int)(2ll * adu / denom);
+	long long rem = numer % denom, remStep = 2ll * adu % denom;
+	int tStart = 0;
+	for (int k = 0; k <= adv && tStart <= tLimit; k++) {
+		if (k == adv)
+			tNext = adu + 1;
+		int tEnd = std::min(tNext - 1, tLimit);
+		const uint64_t* line = bits + (size_t)(v0 + sv * k) * wordsPerLine;
+		int a = su > 0 ? u0 + tStart : u0 - tEnd, b = su > 0 ? u0 + tEnd : u0 - tStart;
+		if ((a >> 6) == (b >> 6)) {
+			// 常见情况：区段落在同一个字内
+			uint64_t word = line[a >> 6] & (~0ull << (a & 63)) & (~0ull >> (63 - (b & 63)));
+			if (word)
+				return su > 0 ? (a & ~63) + std::countr_zero(word) - u0 : u0 - ((a & ~63) + 63 - std::countl_zero(word));
+		} else {
+			int hit = su > 0 ? FirstSetForward(line, a, b) : FirstSetBackward(line, a, b);
+			if (hit >= 0)
+				return su > 0 ? hit - u0 : u0 - hit;
+		}
+		tStart = tNext;
+		tNext += quotStep;
+		rem += remStep;
+		if (rem >= denom) {
+			rem -= denom;
+			tNext++;
+		}
+	}
+	return -1;
+}
+
+bool LineOfSight::Visible(Point a, Point b) const {
+	if (!InRange(a) || !InRange(b))
+		return false;
+	int dx = b.X - a.X, dy = b.Y - a.Y;
+	// 统一从主轴坐标较小的一端扫描，使结果与端点顺序无关
+	if (std::abs(dx) >= std::abs(dy)) {
+		if (dx < 0)
+			std::swap(a, b);
+		return Scan(m_RowBits.data(), m_WordsPerRow, a.X, a.Y, b.X - a.X, b.Y - a.Y, std::abs(dx)) < 0;
+	}
+	if (dy < 0)
+		std::swap(a, b);
+	return Scan(m_ColBits.data(), m_WordsPerCol, a.Y, a.X, b.Y - a.Y, b.X - a.X, std::abs(dy)) < 0;
+}
+
+LineOfSight::RayHit LineOfSight::Raycast(Point from, Point to) const {
+	if (!InRange(from))
+		return { true, from, from };
+
+	int dx = to.X - from.X, dy = to.Y - from.Y;
+	int adx = std::abs(dx), ady = std::abs(dy);
+	bool shallow = adx >= ady;
+	int major = shallow ? adx : ady, minor = shallow ? ady : adx;
+	int u0 = shallow ? from.X : from.Y, v0 = shallow ? from.Y : from.X;
+	int du = shallow ? dx : dy, dv = shallow ? dy : dx;
+	int uCount = shallow ? m_Cols : m_Rows, vCount = shallow ? m_Rows : m_Cols;
+
+	// 终点越界时只扫描网格内的前缀，越界的第一格视为阻挡
+	int tLimit = std::min(major, du >= 0 ? uCount - 1 - u0 : u0);
+	int vRoom = dv >= 0 ? vCount - 1 - v0 : v0;
+	if (minor > 0 && MinorOffset(tLimit, major, minor) > vRoom)
+		tLimit = (int)(((2ll * vRoom + 1) * major + 2ll * minor - 1) / (2ll * minor)) - 1;
+
+	int t = shallow ? Scan(m_RowBits.data(), m_WordsPerRow, u0, v0, du, dv, tLimit)
+	                : Scan(m_ColBits.data(), m_WordsPerCol, u0, v0, du, dv, tLimit);
+	if (t < 0 && tLimit < major)
+		t = tLimit + 1;
+	if (t < 0)
+		return { false, to, to };
+	return { true, StepPoint(from, dx, dy, t), StepPoint(from, dx, dy, std::max(t - 1, 0)) };
+}
+
+void LineOfSight::VisibleBatch(std::span<const Segment> segments, std::span<uint8_t> out, int threads) const {
+	size_t chunks = (segments.size() + BATCH_CHUNK - 1) / BATCH_CHUNK;
+	ParallelFor(chunks, threads, [&](size_t chunk) {
+		size_t end = std::min(segments.size(), (chunk + 1) * BATCH_CHUNK);
+		for (size_t i = chunk * BATCH_CHUNK; i < end; i++)
+			out[i] = Visible(segments[i].From, segments[i].To);
+	});
+}
+
+void LineOfSight::RaycastBatch(std::span<const Segment> segments, std::span<RayHit> out, int threads) const {
+	size_t chunks = (segments.size() + BATCH_CHUNK - 1) / BATCH_CHUNK;
+	ParallelFor(chunks, threads, [&](size_t chunk) {
+		size_t end = std::min(segments.size(), (chunk + 1) * BATCH_CHUNK);
+		for (size_t i = chunk * BATCH_CHUNK; i < end; i++)
+			out[i] = Raycast(segments[i].From, segments[i].To);
+	});
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Cell 网格的视线与射线查询。阻挡格按行打包为 64bit 位图，另存一份转置（按列）位图：
+// 直线按主轴光栅化（四舍五入），同一副轴行/列上的连续区段用字掩码一次检查，
+// 平缓的线用行位图，陡峭的线用列位图。构造完成后只读，可多线程并发查询。
+class LineOfSight {
+public:
+	struct Point {
+		int X;  // Cell 列
+		int Y;  // Cell 行
+	};
+
+	struct Segment {
+		Point From;
+		Point To;
+	};
+
+	struct RayHit {
+		bool Hit;       // 是否被阻挡
+		Point Blocked;  // 第一个阻挡格，Hit 为 false 时无意义
+		Point Last;     // 阻挡前的最后一个可走格，未阻挡时为终点；起点即阻挡时为起点
+	};
+
+	// cells 为 MapX::GetCell() 的 Cell 数组
+	LineOfSight(const uint32_t* cells, int cols, int rows);
+
+	// 越界视为阻挡
+	bool IsBlocked(int x, int y) const;
+
+	// 线段经过的所有格（含两端）都可走时可见；结果与端点顺序无关
+	bool Visible(Point a, Point b) const;
+
+	// 从 from 沿直线走向 to，返回第一个阻挡格
+	RayHit Raycast(Point from, Point to) const;
+
+	// 批量视线查询，out[i] 为 segments[i] 的结果，threads 为 0 时使用硬件线程数
+	void VisibleBatch(std::span<const Segment> segments, std::span<uint8_t> out, int threads = 0) const;
+
+	void RaycastBatch(std::span<const Segment> segments, std::span<RayHit> out, int threads = 0) const;
+
+	int GetCols() const { return m_Cols; }
+	int GetRows() const { return m_Rows; }
+
+	size_t MemoryBytes() const { return (m_RowBits.capacity() + m_ColBits.capacity()) * sizeof(uint64_t); }
+
+private:
+	// 从 (u0, v0) 沿 (du, dv) 方向扫描主轴前 tLimit + 1 步（|du| >= |dv|），bits 的第 v 行第 u 位为 (u, v) 是否阻挡；
+	// 返回第一个阻挡格的主轴步数，无阻挡返回 -1
+	static int Scan(const uint64_t* bits, int wordsPerLine, int u0, int v0, int du, int dv, int tLimit);
+
+	// 主轴第 t 步的副轴偏移（四舍五入），major >= minor >= 0
+	static int MinorOffset(int t, int major, int minor) { return major ? (int)((2ll * t * minor + major) / (2ll * major)) : 0; }
+
+	// 点在直线第 t 步的位置
+	static Point StepPoint(Point from, int dx, int dy, int t);
+
+	bool InRange(Point p) const { return p.X >= 0 && p.Y >= 0 && p.X < m_Cols && p.Y < m_Rows; }
+
+	int m_Cols;
+	int m_Rows;
+	int m_WordsPerRow;
+	int m_WordsPerCol;
+
+	std::vector<uint64_t> m_RowBits;  // 第 y 行第 x 位
+	std::vector<uint64_t> m_ColBits;  // 第 x 列第 y 位
+};
@@ -0,0 +1,116 @@
+#include "mappedfile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_file = std::exchange(other.m_file, nullptr);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t *>(view);
+    m_size = size.QuadPart;
+    return true;
+}
+
+void MappedFile::prefetch(std::span<const uint8_t> range) {
+    if (range.empty())
+        return;
+    WIN32_MEMORY_RANGE_ENTRY entry;
+    entry.VirtualAddress = const_cast<uint8_t *>(range.data());
+    entry.NumberOfBytes = range.size();
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+}
+
+void MappedFile::close() {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // 映射建立后即可关闭描述符
+    if (view == MAP_FAILED)
+        return false;
+    m_data = static_cast<const uint8_t *>(view);
+    m_size = st.st_size;
+    return true;
+}
+
+void MappedFile::prefetch(std::span<const uint8_t> range) {
+    if (range.empty())
+        return;
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t) range.data() & ~(page - 1);
+    madvise((void *) begin, (uintptr_t) range.data() + range.size() - begin, MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+    if (m_data)
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// 只读内存映射文件，映射期间 data() 一直有效
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &path) { open(path); }
+
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const std::string &path);
+
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+
+    const uint8_t *data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+    std::span<const uint8_t> bytes() const { return {m_data, m_size}; }
+
+    // 提示系统预读映射中的一段内存（按页对齐），不等待完成
+    static void prefetch(std::span<const uint8_t> range);
+
+private:
+    const uint8_t *m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    void *m_file{nullptr};
+    void *m_mapping{nullptr};
+#endif
+};
+
+
+#endif //MAPPEDFILE_H
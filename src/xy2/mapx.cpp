@@ -1,22 +1,36 @@
 // #include "pch.h"
 #include "mapx.h"
+#include "parallel.h"
 #include <iostream>
 #include <string>
 #include <memory>
-#include<windows.h>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAPX_USE_SSE2 1
+#else
+#define MAPX_USE_SSE2 0
+#endif
 using std::ios;
 
 #define MEM_READ_WITH_OFF(off,dst,src,len) if(off+len<=src.size()){  memcpy((uint8_t*)dst,(uint8_t*)(src.data()+off),len);off+=len;   }
 #define MEM_COPY_WITH_OFF(off,dst,src,len) {  memcpy(dst,src+off,len);off+=len;   }
 
 
-MapX::MapX(std::string filename, int direction) :m_FileName(filename), m_ScanDirection(direction) {
+MapX::MapX(std::string filename, int direction, bool quiet) :m_FileName(filename), m_ScanDirection(direction), m_Quiet(quiet) {
 	std::fstream fs(m_FileName, ios::in | ios::binary);
 	if (!fs) {
-		std::cerr << "Map file open error!" << m_FileName << std::endl;
+		if (!m_Quiet)
+			std::cerr << "Map file open error!" << m_FileName << std::endl;
 		return;
 	}
-	std::clog << "InitMAP:" << m_FileName.c_str() << std::endl;
+	if (!m_Quiet)
+		std::clog << "InitMAP:" << m_FileName.c_str() << std::endl;
 
 	auto fpos = fs.tellg();
 	fs.seekg(0, std::ios::end);
@@ -36,7 +50,8 @@ MapX::MapX(std::string filename, int direction) :m_FileName(filename), m_ScanDir
 		m_MapType = 1;
 	}
 	else {
-		std::cerr << "Map file format error!" << std::endl;
+		if (!m_Quiet)
+			std::cerr << "Map file format error!" << std::endl;
 		return;
 	}
 
@@ -57,6 +72,8 @@ MapX::MapX(std::string filename, int direction) :m_FileName(filename), m_ScanDir
 
 	m_BlockCount = m_RowCount * m_ColCount;
 	m_Blocks.resize(m_BlockCount);
+	m_BlockState.resize(m_BlockCount, 0);
+	m_BlockRGB.resize(m_BlockCount);
 	m_BlockOffsets.resize(m_BlockCount, 0);
 	MEM_READ_WITH_OFF(fileOffset, m_BlockOffsets.data(), m_FileData, m_BlockCount * 4);
 
@@ -81,7 +98,12 @@ MapX::MapX(std::string filename, int direction) :m_FileName(filename), m_ScanDir
 
 	DecodeMapBlocks();  // 读取JPEG基本信息和旧地图Mask索引
 
-	std::clog << "MAP init success!" << std::endl;
+	BuildMaskRelations();
+
+	BuildMaskGrid();
+
+	if (!m_Quiet)
+		std::clog << "MAP init success! index: " << IndexMemoryBytes() << " bytes" << std::endl;
 }
 
 void MapX::DecodeNewMapMasks() {
@@ -93,7 +115,6 @@ void MapX::DecodeNewMapMasks() {
 		MEM_READ_WITH_OFF(offset, &basicMaskInfo, m_FileData, sizeof(BasicMaskInfo));
 
 		MaskInfo& maskInfo = m_Masks[index];
-		maskInfo.id = index;
 		maskInfo.StartX = basicMaskInfo.StartX;
 		maskInfo.StartY = basicMaskInfo.StartY;
 		maskInfo.Width = basicMaskInfo.Width;
@@ -112,10 +133,7 @@ void MapX::DecodeNewMapMasks() {
 			{
 				int unit = i * m_ColCount + j;
 				if (unit >= 0 && unit < m_Blocks.size())
-				{
-					maskInfo.OccupyBlocks.insert(unit);
-					m_Blocks[unit].OwnMasks.insert((int)index);
-				}
+					m_MaskBlockPairs.emplace_back(unit, (int)index);
 			}
 	}
 }
@@ -129,21 +147,18 @@ void MapX::DecodeOldMapMask(uint32_t offset, int blockIndex, int size) {
 	essenMaskInfo.StartX = (col * 320) + essenMaskInfo.StartX;
 	essenMaskInfo.StartY = (row * 240) + essenMaskInfo.StartY;
 
-	auto key = std::make_pair(essenMaskInfo.StartX, essenMaskInfo.StartY);
-	if (m_NoRepeatMasks.count(key) == 0) {  // 未找到，即为新Mask
-		int id = m_NoRepeatMasks.size();  // id 从0开始
-		m_NoRepeatMasks[key] = id;  // 插入到m_NoRepeatMasks
+	int id = m_NoRepeatMasks.Find(essenMaskInfo.StartX, essenMaskInfo.StartY);
+	if (id < 0) {  // 未找到，即为新Mask
+		id = m_Masks.size();  // id 从0开始
+		m_NoRepeatMasks.Insert(essenMaskInfo.StartX, essenMaskInfo.StartY, id);
 
 		MaskInfo maskInfo;
-		maskInfo.id = id;
 		maskInfo.StartX = essenMaskInfo.StartX;
 		maskInfo.StartY = essenMaskInfo.StartY;
 		maskInfo.Width = essenMaskInfo.Width;
 		maskInfo.Height = essenMaskInfo.Height;
 		maskInfo.Size = size - sizeof(essenMaskInfo);
 		maskInfo.MaskOffset = offset;
-		maskInfo.OccupyBlocks.insert(blockIndex);
-		m_Blocks[blockIndex].OwnMasks.insert((int)id);
 
 		maskInfo.occupyRowStart = maskInfo.StartY / m_BlockHeight;
 		maskInfo.occupyRowEnd = (maskInfo.StartY + maskInfo.Height) / m_BlockHeight;
@@ -153,11 +168,187 @@ void MapX::DecodeOldMapMask(uint32_t offset, int blockIndex, int size) {
 
 		m_Masks.push_back(maskInfo);
 	}
-	else {  // 找到，更新信息
-		int id = m_NoRepeatMasks[key];
-		m_Blocks[blockIndex].OwnMasks.insert(id);
-		m_Masks[id].OccupyBlocks.insert(blockIndex);
+	m_MaskBlockPairs.emplace_back(blockIndex, id);
+}
+
+void MapX::BuildMaskRelations() {
+	size_t maskCount = m_Masks.size();
+	m_MaskState.assign(maskCount, 0);
+	m_MaskRGBA.resize(maskCount);
+	m_MaskAlpha.resize(maskCount);
+
+	std::sort(m_MaskBlockPairs.begin(), m_MaskBlockPairs.end());
+	m_MaskBlockPairs.erase(std::unique(m_MaskBlockPairs.begin(), m_MaskBlockPairs.end()), m_MaskBlockPairs.end());
+
+	// 图块 -> 遮罩：pairs 已按 (图块, 遮罩) 排序
+	m_BlockMaskStart.assign(m_BlockCount + 1, 0);
+	m_BlockMaskIds.resize(m_MaskBlockPairs.size());
+	for (size_t i = 0; i < m_MaskBlockPairs.size(); i++) {
+		m_BlockMaskStart[m_MaskBlockPairs[i].first + 1]++;
+		m_BlockMaskIds[i] = m_MaskBlockPairs[i].second;
+	}
+	for (size_t i = 0; i < m_BlockCount; i++)
+		m_BlockMaskStart[i + 1] += m_BlockMaskStart[i];
+
+	// 遮罩 -> 图块：计数排序，按图块顺序写入，各遮罩内天然升序
+	m_MaskBlockStart.assign(maskCount + 1, 0);
+	m_MaskBlockIds.resize(m_MaskBlockPairs.size());
+	for (auto& pair : m_MaskBlockPairs)
+		m_MaskBlockStart[pair.second + 1]++;
+	for (size_t i = 0; i < maskCount; i++)
+		m_MaskBlockStart[i + 1] += m_MaskBlockStart[i];
+	std::vector<uint32_t> cursor(m_MaskBlockStart.begin(), m_MaskBlockStart.end() - 1);
+	for (auto& pair : m_MaskBlockPairs)
+		m_MaskBlockIds[cursor[pair.second]++] = pair.first;
+
+	std::vector<std::pair<int, int>>().swap(m_MaskBlockPairs);
+	m_NoRepeatMasks.Clear();
+}
+
+void MapX::BuildMaskGrid() {
+	m_MaskGridStart.assign(m_BlockCount + 1, 0);
+	auto forEachCell = [this](const MaskInfo& mask, auto&& fn) {
+		int colStart, rowStart, colEnd, rowEnd;
+		if (!GridRange(mask.StartX, mask.StartY, mask.StartX + (int)mask.Width, mask.StartY + (int)mask.Height, colStart, rowStart, colEnd, rowEnd))
+			return;
+		for (int row = rowStart; row < rowEnd; row++)
+			for (int col = colStart; col < colEnd; col++)
+				fn(row * m_ColCount + col);
+	};
+
+	for (auto& mask : m_Masks)
+		forEachCell(mask, [this](int cell) { m_MaskGridStart[cell + 1]++; });
+	for (size_t i = 0; i < m_BlockCount; i++)
+		m_MaskGridStart[i + 1] += m_MaskGridStart[i];
+
+	m_MaskGridIds.resize(m_MaskGridStart.back());
+	std::vector<uint32_t> cursor(m_MaskGridStart.begin(), m_MaskGridStart.end() - 1);
+	for (int i = 0, count = (int)m_Masks.size(); i < count; i++)
+		forEachCell(m_Masks[i], [&](int cell) { m_MaskGridIds[cursor[cell]++] = i; });
+}
+
+bool MapX::GridRange(int left, int top, int right, int bottom, int& colStart, int& rowStart, int& colEnd, int& rowEnd) const {
+	left = std::max(left, 0);
+	top = std::max(top, 0);
+	right = std::min(right, (int)m_ColCount * m_BlockWidth);
+	bottom = std::min(bottom, (int)m_RowCount * m_BlockHeight);
+	if (left >= right || top >= bottom)
+		return false;
+	colStart = left / m_BlockWidth;
+	rowStart = top / m_BlockHeight;
+	colEnd = (right - 1) / m_BlockWidth + 1;
+	rowEnd = (bottom - 1) / m_BlockHeight + 1;
+	return true;
+}
+
+void MapX::QueryMasks(int left, int top, int right, int bottom, std::vector<int>& out) const {
+	out.clear();
+	int colStart, rowStart, colEnd, rowEnd;
+	if (!GridRange(left, top, right, bottom, colStart, rowStart, colEnd, rowEnd))
+		return;
+	for (int row = rowStart; row < rowEnd; row++) {
+		for (int col = colStart; col < colEnd; col++) {
+			int cell = row * m_ColCount + col;
+			for (uint32_t k = m_MaskGridStart[cell]; k < m_MaskGridStart[cell + 1]; k++) {
+				const MaskInfo& mask = m_Masks[m_MaskGridIds[k]];
+				int x0 = std::max(left, mask.StartX);
+				int y0 = std::max(top, mask.StartY);
+				if (x0 >= std::min(right, mask.StartX + (int)mask.Width) || y0 >= std::min(bottom, mask.StartY + (int)mask.Height))
+					continue;
+				// 只在交集左上角所在的格子里输出，避免跨格子的遮罩重复
+				if (std::max(x0, 0) / m_BlockWidth == col && std::max(y0, 0) / m_BlockHeight == row)
+					out.push_back(m_MaskGridIds[k]);
+			}
+		}
+	}
+}
+
+void MapX::QueryMasksAt(int x, int y, std::vector<int>& out) const {
+	QueryMasks(x, y, x + 1, y + 1, out);
+}
+
+void MapX::QueryBlocks(int left, int top, int right, int bottom, std::vector<int>& out) const {
+	out.clear();
+	int colStart, rowStart, colEnd, rowEnd;
+	if (!GridRange(left, top, right, bottom, colStart, rowStart, colEnd, rowEnd))
+		return;
+	for (int row = rowStart; row < rowEnd; row++)
+		for (int col = colStart; col < colEnd; col++)
+			out.push_back(row * m_ColCount + col);
+}
+
+MapX::CellRange MapX::QueryCells(int left, int top, int right, int bottom, std::vector<uint32_t>& out) const {
+	out.clear();
+	CellRange range{ std::max(left, 0) / 20, std::max(top, 0) / 20, 0, 0 };
+	int colEnd = std::min((right + 19) / 20, m_CellColCount);
+	int rowEnd = std::min((bottom + 19) / 20, m_CellRowCount);
+	if (range.ColStart >= colEnd || range.RowStart >= rowEnd)
+		return range;
+	range.ColCount = colEnd - range.ColStart;
+	range.RowCount = rowEnd - range.RowStart;
+	out.reserve(range.ColCount * range.RowCount);
+	for (int row = range.RowStart; row < rowEnd; row++) {
+		const uint32_t* cell = m_Cell.data() + row * m_CellColCount;
+		out.insert(out.end(), cell + range.ColStart, cell + colEnd);
 	}
+	return range;
+}
+
+size_t MapX::IndexMemoryBytes() const {
+	return m_Blocks.capacity() * sizeof(BlockInfo)
+		+ m_BlockState.capacity()
+		+ m_BlockRGB.capacity() * sizeof(std::vector<uint8_t>)
+		+ (m_BlockMaskStart.capacity() + m_BlockMaskIds.capacity()) * sizeof(uint32_t)
+		+ m_Masks.capacity() * sizeof(MaskInfo)
+		+ m_MaskState.capacity()
+		+ (m_MaskRGBA.capacity() + m_MaskAlpha.capacity()) * sizeof(std::vector<uint8_t>)
+		+ (m_MaskBlockStart.capacity() + m_MaskBlockIds.capacity()) * sizeof(uint32_t)
+		+ (m_MaskGridStart.capacity() + m_MaskGridIds.capacity()) * sizeof(uint32_t)
+		+ m_Cell.capacity() * sizeof(uint32_t);
+}
+
+size_t MapX::MaskKeyTable::Slot(uint64_t key) const {
+	// splitmix64 混合，容量为 2 的幂
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebull;
+	key ^= key >> 31;
+	return key & (m_Keys.size() - 1);
+}
+
+int MapX::MaskKeyTable::Find(int x, int y) const {
+	if (m_Keys.empty())
+		return -1;
+	uint64_t key = Key(x, y);
+	for (size_t slot = Slot(key);; slot = (slot + 1) & (m_Keys.size() - 1)) {
+		if (m_Ids[slot] < 0)
+			return -1;
+		if (m_Keys[slot] == key)
+			return m_Ids[slot];
+	}
+}
+
+void MapX::MaskKeyTable::Insert(int x, int y, int id) {
+	if ((m_Count + 1) * 2 > m_Keys.size()) {  // 负载不超过 1/2
+		std::vector<uint64_t> keys(std::max<size_t>(64, m_Keys.size() * 2));
+		std::vector<int> ids(keys.size(), -1);
+		keys.swap(m_Keys);
+		ids.swap(m_Ids);
+		m_Count = 0;
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (ids[i] >= 0)
+				Insert((int)(keys[i] >> 32), (int)(uint32_t)keys[i], ids[i]);
+		}
+	}
+	uint64_t key = Key(x, y);
+	size_t slot = Slot(key);
+	while (m_Ids[slot] >= 0 && m_Keys[slot] != key)
+		slot = (slot + 1) & (m_Keys.size() - 1);
+	if (m_Ids[slot] < 0)
+		m_Count++;
+	m_Keys[slot] = key;
+	m_Ids[slot] = id;
 }
 
 void MapX::DecodeMapBlocks() {
@@ -204,24 +395,17 @@ void MapX::DecodeMapBlocks() {
 }
 
 void MapX::ReadCell(uint32_t offset, uint32_t size, uint32_t index) {
-	m_Blocks[index].Cell.resize(size, 0);
-	MEM_READ_WITH_OFF(offset, m_Blocks[index].Cell.data(), m_FileData, size);
+	// 每个图块 16 x 12 个 Cell，直接写入整张地图的 m_Cell
+	if (offset + size > m_FileData.size())
+		return;
+	const uint8_t* cell = m_FileData.data() + offset;
 	int cellRow = (index / m_ColCount) * 12;
 	int cellCol = (index % m_ColCount) * 16;
-	int count = 0;
-	for (int i = 0; i < m_Blocks[index].Cell.size(); i++) {
-		if (cellRow * m_CellColCount + cellCol + count > m_Cell.size()) {
-			std::cout << "?" << std::endl;
-		}
-		if (i > m_Blocks[index].Cell.size()) {
-			std::cout << "!" << std::endl;
-		}
-		m_Cell[cellRow * m_CellColCount + cellCol + count] = m_Blocks[index].Cell[i];
-		count++;
-		if (count >= 16) {
-			count = 0;
-			cellRow++;
-		}
+	for (uint32_t i = 0; i < size; i++) {
+		size_t pos = (size_t)(cellRow + i / 16) * m_CellColCount + cellCol + i % 16;
+		if (pos >= m_Cell.size())
+			break;
+		m_Cell[pos] = cell[i];
 	}
 }
 
@@ -230,10 +414,10 @@ void  MapX::ReadBrig(uint32_t offset, uint32_t size, uint32_t index) {
 }
 
 bool MapX::ReadJPEG(int index) {
-	if (m_Blocks[index].bHasLoad || m_Blocks[index].bLoading) {
-		return m_Blocks[index].bHasLoad;
+	if (m_BlockState[index] & (LS_LOADED | LS_LOADING)) {
+		return m_BlockState[index] & LS_LOADED;
 	}
-	m_Blocks[index].bLoading = true;
+	m_BlockState[index] |= LS_LOADING;
 
 	int size = m_Blocks[index].JpegSize;
 	std::vector<uint8_t> jpegData(size, 0);
@@ -249,25 +433,24 @@ bool MapX::ReadJPEG(int index) {
 			return 0;
 		if (!m_ujpeg.isValid())
 			return 0;
-		m_Blocks[index].JPEGRGB24.resize(230400);
-		m_ujpeg.getImage(m_Blocks[index].JPEGRGB24.data());
+		m_BlockRGB[index].resize(230400);
+		m_ujpeg.getImage(m_BlockRGB[index].data());
 	}
 	else {
-		m_Blocks[index].JPEGRGB24.resize(size * 2, 0);
-		MapHandler(jpegData.data(), size, m_Blocks[index].JPEGRGB24.data(), &tmpSize);
-		bool result = m_ujpeg.decode(m_Blocks[index].JPEGRGB24.data(), tmpSize, false);
+		m_BlockRGB[index].resize(size * 2, 0);
+		MapHandler(jpegData.data(), size, m_BlockRGB[index].data(), &tmpSize);
+		bool result = m_ujpeg.decode(m_BlockRGB[index].data(), tmpSize, false);
 		if (!result)
 			return 0;
 		if (!m_ujpeg.isValid())
 			return 0;
-		m_Blocks[index].JPEGRGB24.resize(230400);
-		m_ujpeg.getImage(m_Blocks[index].JPEGRGB24.data());
+		m_BlockRGB[index].resize(230400);
+		m_ujpeg.getImage(m_BlockRGB[index].data());
 	}
 
-	m_Blocks[index].bHasLoad = true;
-	m_Blocks[index].bLoading = false;
+	m_BlockState[index] = LS_LOADED;
 
-	return m_Blocks[index].bHasLoad;
+	return true;
 }
 
 void MapX::ByteSwap(uint16_t& value) {
@@ -555,117 +738,162 @@ eof_found:
 	return (op - (uint8_t*)out);
 }
 
-void MapX::ReadMaskOrigin(int index) {
-	if (m_Masks[index].bHasLoad || m_Masks[index].bLoading) {
-		return;
+namespace {
+	// 2bit 遮罩值对应的 Alpha：0 无遮罩，1/2 边缘，3 遮挡
+	constexpr uint8_t MASK_ALPHA_LEVELS[4] = { 0, 1, 1, 150 };
+
+	// 一个字节（4个像素）到 4 个 Alpha 值的查找表
+	struct MaskAlphaTable {
+		uint8_t v[256][4];
+
+		constexpr MaskAlphaTable() : v() {
+			for (int b = 0; b < 256; b++)
+				for (int k = 0; k < 4; k++)
+					v[b][k] = MASK_ALPHA_LEVELS[(b >> (k * 2)) & 3];
+		}
+	};
+
+	constexpr MaskAlphaTable MASK_ALPHA_TABLE;
+}
+
+void MapX::UnpackMaskAlpha(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, bool flip) {
+	uint32_t stride = (width + 3) / 4;	// 每行按 4 像素对齐
+
+#if MAPX_USE_SSE2
+	const __m128i three = _mm_set1_epi8(3);
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i level3 = _mm_set1_epi8((char)MASK_ALPHA_LEVELS[3]);
+	auto toAlpha = [&](__m128i c) {
+		__m128i isFull = _mm_cmpeq_epi8(c, three);
+		return _mm_or_si128(_mm_andnot_si128(isFull, _mm_min_epu8(c, one)), _mm_and_si128(isFull, level3));
+	};
+#endif
+
+	for (uint32_t i = 0; i < height; i++) {
+		const uint8_t* s = src + i * stride;
+		uint8_t* d = dst + (flip ? height - 1 - i : i) * width;
+		uint32_t j = 0;
+
+#if MAPX_USE_SSE2
+		// 每次 16 字节 -> 64 个像素
+		for (; j + 64 <= width; j += 64, s += 16) {
+			__m128i in = _mm_loadu_si128((const __m128i*)s);
+			__m128i c0 = toAlpha(_mm_and_si128(in, three));
+			__m128i c1 = toAlpha(_mm_and_si128(_mm_srli_epi16(in, 2), three));
+			__m128i c2 = toAlpha(_mm_and_si128(_mm_srli_epi16(in, 4), three));
+			__m128i c3 = toAlpha(_mm_and_si128(_mm_srli_epi16(in, 6), three));
+
+			__m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+			__m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+			__m128i lo23 = _mm_unpacklo_epi8(c2, c3);
+			__m128i hi23 = _mm_unpackhi_epi8(c2, c3);
+
+			_mm_storeu_si128((__m128i*)(d + j), _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)(d + j + 16), _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)(d + j + 32), _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i*)(d + j + 48), _mm_unpackhi_epi16(hi01, hi23));
+		}
+#endif
+
+		for (; j + 4 <= width; j += 4, s++)
+			memcpy(d + j, MASK_ALPHA_TABLE.v[*s], 4);
+
+		for (int k = 0; j < width; j++, k++)
+			d[j] = MASK_ALPHA_TABLE.v[*s][k];
 	}
-	m_Masks[index].bLoading = true;
+}
 
+void MapX::DecodeMaskData(int index, std::vector<uint8_t>& out) const {
 	int fileOffset = m_Masks[index].MaskOffset;
 	std::vector<uint8_t> pData(m_Masks[index].Size, 0);
 	MEM_READ_WITH_OFF(fileOffset, pData.data(), m_FileData, m_Masks[index].Size);
 
 	int align_width = (m_Masks[index].Width + 3) / 4;	// align 4 bytes
 	int size = align_width * m_Masks[index].Height;
-	std::vector<uint8_t> pMaskDataDec(size, 0);
+	out.assign(size, 0);
 
-	DecompressMask(pData.data(), pMaskDataDec.data());
+	DecompressMask(pData.data(), out.data());
+}
 
-	// 至此所需图块全部加载完毕，现在读取像素
-	m_Masks[index].RGBA.resize(m_Masks[index].Width * m_Masks[index].Height * 4, 255);
-
-	int maskIndex = 0;
-	for (int i = 0; i < m_Masks[index].Height; i++) {
-		int counter4 = 0;
-		for (int j = 0; j < m_Masks[index].Width; j++) {
-			int pos = i * m_Masks[index].Width + j;
-			uint8_t byte = pMaskDataDec[maskIndex];
-
-			uint8_t flag = (byte >> counter4 * 2) & 3;
-			counter4++;
-			if (counter4 >= 4) {
-				counter4 = 0;
-				maskIndex++;
-			}
+void MapX::DecodeMaskAlpha(int index, std::vector<uint8_t>& alpha, bool flip) const {
+	std::vector<uint8_t> data;
+	DecodeMaskData(index, data);
+	alpha.resize(m_Masks[index].Width * m_Masks[index].Height);
+	UnpackMaskAlpha(data.data(), m_Masks[index].Width, m_Masks[index].Height, alpha.data(), flip);
+}
 
-			if (flag > 0) {
-				int cur = pos;
-				if (m_ScanDirection == 1) {
-					cur = (m_Masks[index].Height - 1 - i) * m_Masks[index].Width + j;
-				}
+void MapX::ReadMaskAlpha(int index) {
+	if (m_MaskState[index] & (LS_LOADED | LS_LOADING)) {
+		return;
+	}
+	m_MaskState[index] |= LS_LOADING;
 
-				m_Masks[index].RGBA[cur * 4 + 3] = flag == 3 ? 150 : 1;
-			}
-		}
-		if (counter4 != 0) {
-			counter4 = 0;
-			maskIndex++;
-		}
+	DecodeMaskAlpha(index, m_MaskAlpha[index], m_ScanDirection == 1);
+
+	m_MaskState[index] = LS_LOADED;
+}
+
+void MapX::ReadMaskOrigin(int index) {
+	if (m_MaskState[index] & (LS_LOADED | LS_LOADING)) {
+		return;
 	}
+	m_MaskState[index] |= LS_LOADING;
 
-	m_Masks[index].bHasLoad = true;
-	m_Masks[index].bLoading = false;
+	std::vector<uint8_t> pMaskDataDec;
+	DecodeMaskData(index, pMaskDataDec);
+
+	uint32_t pixelCount = m_Masks[index].Width * m_Masks[index].Height;
+	std::vector<uint8_t> alpha(pixelCount);
+	UnpackMaskAlpha(pMaskDataDec.data(), m_Masks[index].Width, m_Masks[index].Height, alpha.data(), m_ScanDirection == 1);
+
+	// 至此所需图块全部加载完毕，现在读取像素
+	m_MaskRGBA[index].resize(pixelCount * 4, 255);
+	for (uint32_t p = 0; p < pixelCount; p++) {
+		if (alpha[p] > 0)
+			m_MaskRGBA[index][p * 4 + 3] = alpha[p];
+	}
+
+	m_MaskState[index] = LS_LOADED;
 }
 
 
 void MapX::ReadMask(int index) {
-	if (m_Masks[index].bHasLoad || m_Masks[index].bLoading) {
+	if (m_MaskState[index] & (LS_LOADED | LS_LOADING)) {
 		return;
 	}
-	m_Masks[index].bLoading = true;
-
-	int fileOffset = m_Masks[index].MaskOffset;
-	std::vector<uint8_t> pData(m_Masks[index].Size, 0);
-	MEM_READ_WITH_OFF(fileOffset, pData.data(), m_FileData, m_Masks[index].Size);
-
-	int align_width = (m_Masks[index].Width + 3) / 4;	// align 4 bytes
-	int size = align_width * m_Masks[index].Height;
-	std::vector<uint8_t> pMaskDataDec(size, 0);
+	m_MaskState[index] |= LS_LOADING;
 
-	DecompressMask(pData.data(), pMaskDataDec.data());
+	std::vector<uint8_t> pMaskDataDec;
+	DecodeMaskData(index, pMaskDataDec);
 
 	for (int i = m_Masks[index].occupyRowStart; i <= m_Masks[index].occupyRowEnd; i++)
 		for (int j = m_Masks[index].occupyColStart; j <= m_Masks[index].occupyColEnd; j++)
 			while (!ReadJPEG(i, j))  // 读取所有涉及到的图块
-				Sleep(100);  // 走到这里，即为Block -> bHasLoad 为false，bLoading为true，即有其他线程在读当前块。等待100ms
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));  // 走到这里，即为图块未加载完成且处于 LS_LOADING，即有其他线程在读当前块。等待100ms
+
+	uint32_t width = m_Masks[index].Width;
+	uint32_t height = m_Masks[index].Height;
+	std::vector<uint8_t> alpha(width * height);
+	UnpackMaskAlpha(pMaskDataDec.data(), width, height, alpha.data(), m_ScanDirection == 1);
 
 	// 至此所需图块全部加载完毕，现在读取像素
-	m_Masks[index].RGBA.resize(m_Masks[index].Width * m_Masks[index].Height * 4, 0);  // 全部初始化为全透明
-
-	int maskIndex = 0;
-	for (int i = 0; i < m_Masks[index].Height; i++) {
-		int counter4 = 0;
-		for (int j = 0; j < m_Masks[index].Width; j++) {
-			int pos = i * m_Masks[index].Width + j;
-			uint8_t byte = pMaskDataDec[maskIndex];
-
-			uint8_t flag = (byte >> counter4 * 2) & 3;
-			counter4++;
-			if (counter4 >= 4) {
-				counter4 = 0;
-				maskIndex++;
-			}
+	m_MaskRGBA[index].resize(width * height * 4, 0);  // 全部初始化为全透明
 
-			if (flag > 0) {
-				int cur = pos;
-				if (m_ScanDirection == 1) {
-					cur = (m_Masks[index].Height - 1 - i) * m_Masks[index].Width + j;
-				}
+	for (uint32_t i = 0; i < height; i++) {
+		uint32_t row = m_ScanDirection == 1 ? height - 1 - i : i;
+		for (uint32_t j = 0; j < width; j++) {
+			int cur = row * width + j;
+			if (alpha[cur] > 0) {
 				RGBA rgba = ReadPixel(m_Masks[index].StartX + j, m_Masks[index].StartY + i);  // 读像素
-				m_Masks[index].RGBA[cur * 4] = rgba.R;
-				m_Masks[index].RGBA[cur * 4 + 1] = rgba.G;
-				m_Masks[index].RGBA[cur * 4 + 2] = rgba.B;
-				m_Masks[index].RGBA[cur * 4 + 3] = flag == 3 ? 150 : 1;
+				m_MaskRGBA[index][cur * 4] = rgba.R;
+				m_MaskRGBA[index][cur * 4 + 1] = rgba.G;
+				m_MaskRGBA[index][cur * 4 + 2] = rgba.B;
+				m_MaskRGBA[index][cur * 4 + 3] = alpha[cur];
 			}
 		}
-		if (counter4 != 0) {
-			counter4 = 0;
-			maskIndex++;
-		}
 	}
 
-	m_Masks[index].bHasLoad = true;
-	m_Masks[index].bLoading = false;
+	m_MaskState[index] = LS_LOADED;
 }
 
 MapX::RGBA MapX::ReadPixel(int x, int y) {
@@ -685,9 +913,205 @@ MapX::RGBA MapX::ReadPixel(int x, int y) {
 
 	RGBA rgba;
 
-	rgba.R = m_Blocks[index].JPEGRGB24[pos];
-	rgba.G = m_Blocks[index].JPEGRGB24[pos + 1];
-	rgba.B = m_Blocks[index].JPEGRGB24[pos + 2];
+	rgba.R = m_BlockRGB[index][pos];
+	rgba.G = m_BlockRGB[index][pos + 1];
+	rgba.B = m_BlockRGB[index][pos + 2];
 
 	return rgba;
 }
+
+void MapX::BuildOcclusion(int threads) {
+	size_t maskCount = m_Masks.size();
+	std::vector<MaskOcclusion> occlusion(maskCount);
+	std::vector<std::vector<uint64_t>> bits(maskCount);
+
+	auto build = [&](size_t index) {
+		const MaskInfo& mask = m_Masks[index];
+		std::vector<uint8_t> alpha;
+		DecodeMaskAlpha(index, alpha, false);
+
+		// 紧包围盒
+		int left = mask.Width, top = mask.Height, right = 0, bottom = 0;
+		for (int i = 0; i < (int)mask.Height; i++) {
+			const uint8_t* row = alpha.data() + i * mask.Width;
+			for (int j = 0; j < (int)mask.Width; j++) {
+				if (row[j] > 1) {
+					left = std::min(left, j);
+					right = std::max(right, j + 1);
+					top = std::min(top, i);
+					bottom = i + 1;
+				}
+			}
+		}
+
+		MaskOcclusion& occ = occlusion[index];
+		if (right <= left) {  // 没有遮挡像素
+			occ = { mask.StartX, mask.StartY, mask.StartX, mask.StartY, MaskBaseLine(mask, alpha.data(), false), 0, 0 };
+			return;
+		}
+		occ.Left = mask.StartX + left;
+		occ.Top = mask.StartY + top;
+		occ.Right = mask.StartX + right;
+		occ.Bottom = mask.StartY + bottom;
+		occ.BaseLine = MaskBaseLine(mask, alpha.data(), false);
+		occ.WordsPerRow = (right - left + 63) / 64;
+
+		auto& words = bits[index];
+		words.assign(occ.WordsPerRow * (bottom - top), 0);
+		for (int i = top; i < bottom; i++) {
+			const uint8_t* row = alpha.data() + i * mask.Width;
+			uint64_t* dst = words.data() + (i - top) * occ.WordsPerRow;
+			for (int j = left; j < right; j++) {
+				if (row[j] > 1)
+					dst[(j - left) >> 6] |= 1ull << ((j - left) & 63);
+			}
+		}
+	};
+
+	ParallelFor(maskCount, threads, build);
+
+	size_t total = 0;
+	for (size_t i = 0; i < maskCount; i++) {
+		occlusion[i].BitOffset = total;
+		total += bits[i].size();
+	}
+	m_OcclusionBits.clear();
+	m_OcclusionBits.reserve(total);
+	for (auto& words : bits)
+		m_OcclusionBits.insert(m_OcclusionBits.end(), words.begin(), words.end());
+	m_Occlusion.swap(occlusion);
+}
+
+int MapX::MaskBaseLine(const MaskInfo& mask, const uint8_t* alpha, bool flip) {
+	for (int i = (int)mask.Height - 1; i >= 0; i--) {
+		const uint8_t* row = alpha + (flip ? mask.Height - 1 - i : i) * mask.Width;
+		if (std::any_of(row, row + mask.Width, [](uint8_t a) { return a > 1; }))
+			return mask.StartY + i + 1;
+	}
+	return mask.StartY;
+}
+
+int MapX::GetMaskBaseLine(int maskIndex) const {
+	if (HasOcclusion())
+		return m_Occlusion[maskIndex].BaseLine;
+	return MaskBaseLine(m_Masks[maskIndex], m_MaskAlpha[maskIndex].data(), m_ScanDirection == 1);
+}
+
+bool MapX::MaskCovers(int maskIndex, int x, int y) const {
+	const MaskOcclusion& occ = m_Occlusion[maskIndex];
+	if (x < occ.Left || x >= occ.Right || y < occ.Top || y >= occ.Bottom)
+		return false;
+	uint32_t col = x - occ.Left;
+	const uint64_t* row = m_OcclusionBits.data() + occ.BitOffset + (y - occ.Top) * occ.WordsPerRow;
+	return (row[col >> 6] >> (col & 63)) & 1;
+}
+
+bool MapX::MaskCoversRect(int maskIndex, int left, int top, int right, int bottom) const {
+	const MaskOcclusion& occ = m_Occlusion[maskIndex];
+	left = std::max(left, occ.Left);
+	top = std::max(top, occ.Top);
+	right = std::min(right, occ.Right);
+	bottom = std::min(bottom, occ.Bottom);
+	if (left >= right || top >= bottom)
+		return false;
+
+	// 按 64bit 字检查 [c0, c1) 列
+	uint32_t c0 = left - occ.Left;
+	uint32_t c1 = right - occ.Left;
+	uint32_t w0 = c0 >> 6, w1 = (c1 - 1) >> 6;
+	uint64_t firstMask = ~0ull << (c0 & 63);
+	uint64_t lastMask = ~0ull >> (63 - ((c1 - 1) & 63));
+	for (int y = top; y < bottom; y++) {
+		const uint64_t* row = m_OcclusionBits.data() + occ.BitOffset + (y - occ.Top) * occ.WordsPerRow;
+		if (w0 == w1) {
+			if (row[w0] & firstMask & lastMask)
+				return true;
+			continue;
+		}
+		if (row[w0] & firstMask)
+			return true;
+		for (uint32_t w = w0 + 1; w < w1; w++)
+			if (row[w])
+				return true;
+		if (row[w1] & lastMask)
+			return true;
+	}
+	return false;
+}
+
+void MapX::QueryOccluders(std::span<const OcclusionQuery> queries, std::vector<uint32_t>& offsets, std::vector<int>& masks) const {
+	offsets.resize(queries.size() + 1);
+	masks.clear();
+	offsets[0] = 0;
+	std::vector<int> candidates;
+	for (size_t i = 0; i < queries.size(); i++) {
+		const OcclusionQuery& q = queries[i];
+		int left = q.X - q.HalfWidth, top = q.Y - q.Height, right = q.X + q.HalfWidth, bottom = q.Y;
+		QueryMasks(left, top, right, bottom, candidates);
+		for (int m : candidates) {
+			if (m_Occlusion[m].BaseLine > q.Y && MaskCoversRect(m, left, top, right, bottom))
+				masks.push_back(m);
+		}
+		offsets[i + 1] = masks.size();
+	}
+}
+
+void MapX::BuildMaskPolygons(float tolerance, int threads) {
+	size_t maskCount = m_Masks.size();
+	std::vector<MaskPoly::Rings> rings(maskCount);
+	std::vector<uint64_t> covered(maskCount, 0), mismatch(maskCount, 0);
+
+	ParallelFor(maskCount, threads, [&](size_t index) {
+		const MaskInfo& mask = m_Masks[index];
+		std::vector<uint8_t> alpha;
+		DecodeMaskAlpha(index, alpha, false);
+		MaskPoly::Trace(alpha.data(), mask.Width, mask.Height, tolerance, rings[index]);
+
+		// 与位图逐像素比较
+		std::vector<uint8_t> raster(alpha.size());
+		MaskPoly::Rasterize(rings[index].Points, rings[index].Start, mask.Width, mask.Height, raster.data());
+		for (size_t p = 0; p < alpha.size(); p++) {
+			covered[index] += alpha[p] > 1;
+			mismatch[index] += (alpha[p] > 1) != (raster[p] != 0);
+		}
+
+		for (auto& point : rings[index].Points) {
+			point.X += mask.StartX;
+			point.Y += mask.StartY;
+		}
+	});
+
+	m_PolyPoints.clear();
+	m_PolyRingStart.clear();
+	m_PolyMaskRing.assign(maskCount + 1, 0);
+	m_PolygonStats = {};
+	for (size_t i = 0; i < maskCount; i++) {
+		uint32_t base = m_PolyPoints.size();
+		m_PolyMaskRing[i] = m_PolyRingStart.size();
+		for (size_t r = 0; r < rings[i].Count(); r++)
+			m_PolyRingStart.push_back(base + rings[i].Start[r]);
+		m_PolyPoints.insert(m_PolyPoints.end(), rings[i].Points.begin(), rings[i].Points.end());
+
+		m_PolygonStats.BitmapBytes += (size_t)m_Masks[i].Width * m_Masks[i].Height * 4;
+		m_PolygonStats.CoveredPixels += covered[i];
+		m_PolygonStats.MismatchPixels += mismatch[i];
+		if (covered[i])
+			m_PolygonStats.MaxMismatch = std::max(m_PolygonStats.MaxMismatch, (float)mismatch[i] / covered[i]);
+	}
+	m_PolyMaskRing[maskCount] = m_PolyRingStart.size();
+	m_PolyRingStart.push_back(m_PolyPoints.size());
+	m_PolyPoints.shrink_to_fit();
+	m_PolyRingStart.shrink_to_fit();
+	m_PolygonStats.PolygonBytes = PolygonMemoryBytes();
+
+	std::clog << "MAP polygons: " << m_PolyRingStart.size() - 1 << " rings, " << m_PolyPoints.size() << " points, "
+		<< m_PolygonStats.PolygonBytes << " bytes (bitmap " << m_PolygonStats.BitmapBytes << " bytes), mismatch "
+		<< m_PolygonStats.MismatchPixels << "/" << m_PolygonStats.CoveredPixels << " pixels" << std::endl;
+}
+
+bool MapX::MaskPolygonContains(int maskIndex, int x, int y) const {
+	const MaskInfo& mask = m_Masks[maskIndex];
+	if (x < mask.StartX || y < mask.StartY || x >= mask.StartX + (int)mask.Width || y >= mask.StartY + (int)mask.Height)
+		return false;
+	return MaskPoly::Contains(m_PolyPoints, GetMaskRings(maskIndex), x + 0.5f, y + 0.5f);
+}
@@ -2,21 +2,12 @@
 #include <fstream>
 #include <cstdint>
 #include <vector>
-#include <set>
-#include <unordered_map>
+#include <span>
 #include "ujpeg.h"
+#include "maskpoly.h"
 
-struct MaskKeyHash
-{
-	template<class T1, class T2>
-	std::size_t operator() (const std::pair<T1, T2>& p) const
-	{
-		auto h1 = std::hash<T1>{}(p.first);
-		auto h2 = std::hash<T2>{}(p.second);
-		return (h1 * 1000) + h2;
-	}
-};
-
+// 地图索引（图块/遮罩的几何信息与相互覆盖关系）在构造完成后不再修改，可在多线程间共享只读访问；
+// 图块像素与遮罩像素按需解码，另存于独立的数组中。
 class MapX {
 public:
 	struct EssenMaskInfo {
@@ -31,66 +22,153 @@ public:
 	};
 
 	struct MaskInfo : BasicMaskInfo {
-		int id;
-		std::vector<uint8_t> RGBA;
-		std::set<int> OccupyBlocks;
 		uint32_t MaskOffset;
 		uint32_t occupyRowStart;
 		uint32_t occupyRowEnd;
 		uint32_t occupyColStart;
 		uint32_t occupyColEnd;
-		bool bHasLoad = false;
-		bool bLoading = false;
 	};
 
-	struct MapBlock {
-		std::vector<uint8_t> JPEGRGB24;
-		uint32_t Size;
-		uint32_t Index;
-		std::vector<uint8_t>  Cell;
-		bool bHasLoad = false;
-		bool bLoading = false;
-		uint32_t JpegSize;
+	struct BlockInfo {
 		uint32_t JpegOffset;
-		std::set<int> OwnMasks;
+		uint32_t JpegSize;
 	};
 
-	MapX(std::string filename, int coordinate);
+	// quiet 为 true 时不输出加载信息与错误，供多线程批量读取时使用
+	MapX(std::string filename, int coordinate, bool quiet = false);
 
 	// JPEG
 
-	MapBlock* GetBlockInfo(int index) { return &m_Blocks[index]; };
+	const BlockInfo* GetBlockInfo(int index) const { return &m_Blocks[index]; };
 
-	std::set<int> GetBlockMasks(int index) { return m_Blocks[index].OwnMasks; };
+	// 覆盖该图块的遮罩，升序
+	std::span<const int> GetBlockMasks(int index) const { return { m_BlockMaskIds.data() + m_BlockMaskStart[index], m_BlockMaskIds.data() + m_BlockMaskStart[index + 1] }; };
 
 	bool ReadJPEG(int index);
 
 	bool ReadJPEG(int row, int col) { return ReadJPEG(row * m_ColCount + col); };
 
-	bool HasJPEGLoaded(int index) { return m_Blocks[index].bHasLoad; };
+	bool HasJPEGLoaded(int index) { return m_BlockState[index] & LS_LOADED; };
 
-	uint8_t* GetJPEGRGB(int index) { return m_Blocks[index].JPEGRGB24.data(); };
+	uint8_t* GetJPEGRGB(int index) { return m_BlockRGB[index].data(); };
 
-	void EraseJPEGRGB(int index) { std::vector<uint8_t> v; m_Blocks[index].JPEGRGB24.swap(v); m_Blocks[index].bHasLoad = false; };
+	void EraseJPEGRGB(int index) { std::vector<uint8_t>().swap(m_BlockRGB[index]); m_BlockState[index] &= ~LS_LOADED; };
 
 	// Mask
 
-	MaskInfo* GetMaskInfo(int maskIndex) { return &m_Masks[maskIndex]; };
+	const MaskInfo* GetMaskInfo(int maskIndex) const { return &m_Masks[maskIndex]; };
+
+	// 该遮罩覆盖的图块，升序
+	std::span<const int> GetMaskBlocks(int maskIndex) const { return { m_MaskBlockIds.data() + m_MaskBlockStart[maskIndex], m_MaskBlockIds.data() + m_MaskBlockStart[maskIndex + 1] }; };
 
 	void ReadMask(int index);
 
 	void ReadMaskOrigin(int index);
 
-	bool HasMaskLoaded(int index) { return m_Masks[index].bHasLoad; };
+	void ReadMaskAlpha(int index);
+
+	bool HasMaskLoaded(int index) { return m_MaskState[index] & LS_LOADED; };
+
+	uint8_t* GetMaskRGBA(int index) { return m_MaskRGBA[index].data(); };
+
+	uint8_t* GetMaskAlpha(int index) { return m_MaskAlpha[index].data(); };
+
+	void EraseMaskRGB(int index) { std::vector<uint8_t>().swap(m_MaskRGBA[index]); std::vector<uint8_t>().swap(m_MaskAlpha[index]); m_MaskState[index] &= ~LS_LOADED; };
+
+	// 将解压后的 2bit 遮罩数据展开为 8bit Alpha 平面（0/1/150），flip 为 true 时行倒序写入
+	static void UnpackMaskAlpha(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, bool flip);
+
+	// Occlusion
+
+	// 遮罩的遮挡信息：值为 3 的像素打包为 1bit 位图，只保存紧包围盒内的部分
+	struct MaskOcclusion {
+		int Left;      // 紧包围盒，地图像素，左闭右开
+		int Top;
+		int Right;
+		int Bottom;
+		int BaseLine;  // 基线：脚下 y 小于基线的精灵位于遮罩之后
+		uint32_t WordsPerRow;
+		uint32_t BitOffset;  // 在 m_OcclusionBits 中的起始位置（64bit 字）
+	};
+
+	// 精灵脚下坐标 (X, Y)，精灵范围为 [X - HalfWidth, X + HalfWidth) x [Y - Height, Y)
+	struct OcclusionQuery {
+		int X;
+		int Y;
+		int HalfWidth;
+		int Height;
+	};
+
+	// 解码全部遮罩并建立遮挡信息，threads 为 0 时使用硬件线程数；建立后查询为只读，可多线程调用
+	void BuildOcclusion(int threads = 0);
+
+	bool HasOcclusion() const { return !m_Occlusion.empty() || m_Masks.empty(); }
+
+	const MaskOcclusion& GetMaskOcclusion(int maskIndex) const { return m_Occlusion[maskIndex]; }
+
+	// 遮罩基线（同 MaskOcclusion::BaseLine）：已建立遮挡信息时直接读取，否则须先 ReadMaskAlpha
+	int GetMaskBaseLine(int maskIndex) const;
 
-	uint8_t* GetMaskRGBA(int index) { return m_Masks[index].RGBA.data(); };
+	bool MaskCovers(int maskIndex, int x, int y) const;
 
-	void EraseMaskRGB(int index) { std::vector<uint8_t> v; m_Masks[index].RGBA.swap(v); m_Masks[index].bHasLoad = false; };
+	bool MaskCoversRect(int maskIndex, int left, int top, int right, int bottom) const;
+
+	// 批量查询遮挡每个精灵的遮罩，结果为 CSR：queries[i] 的遮罩为 masks[offsets[i] .. offsets[i + 1])
+	void QueryOccluders(std::span<const OcclusionQuery> queries, std::vector<uint32_t>& offsets, std::vector<int>& masks) const;
+
+	size_t OcclusionMemoryBytes() const { return m_Occlusion.capacity() * sizeof(MaskOcclusion) + m_OcclusionBits.capacity() * sizeof(uint64_t); }
+
+	// Polygon
+
+	// 矢量化统计：与位图遮罩的内存对比，以及按像素中心采样与位图的不一致像素
+	struct PolygonStats {
+		size_t BitmapBytes;      // RGBA 位图 Width * Height * 4 之和
+		size_t PolygonBytes;
+		uint64_t CoveredPixels;  // 位图中的遮挡像素
+		uint64_t MismatchPixels;
+		float MaxMismatch;       // 单个遮罩不一致像素占其遮挡像素的最大比例
+	};
+
+	// 解码全部遮罩并追踪为多边形，tolerance 为化简的最大偏差（像素），threads 为 0 时使用硬件线程数
+	void BuildMaskPolygons(float tolerance = 0.75f, int threads = 0);
+
+	bool HasMaskPolygons() const { return m_PolyMaskRing.size() == m_Masks.size() + 1; }
+
+	// 全部多边形顶点，地图像素坐标
+	std::span<const MaskPoly::Point> GetPolygonPoints() const { return m_PolyPoints; }
+
+	// 遮罩各环在 GetPolygonPoints() 中的起点，末尾附加结束位置，大小为环数 + 1
+	std::span<const uint32_t> GetMaskRings(int maskIndex) const { return { m_PolyRingStart.data() + m_PolyMaskRing[maskIndex], m_PolyRingStart.data() + m_PolyMaskRing[maskIndex + 1] + 1 }; }
+
+	// 像素 (x, y) 的中心是否位于遮罩多边形内
+	bool MaskPolygonContains(int maskIndex, int x, int y) const;
+
+	const PolygonStats& GetPolygonStats() const { return m_PolygonStats; }
+
+	size_t PolygonMemoryBytes() const { return m_PolyPoints.capacity() * sizeof(MaskPoly::Point) + (m_PolyRingStart.capacity() + m_PolyMaskRing.capacity()) * sizeof(uint32_t); }
 
 	// Cell
 
 	uint32_t* GetCell() { return m_Cell.data(); };
 
+	// 空间查询，坐标为地图像素，矩形为左闭右开 [left, right) x [top, bottom)
+
+	struct CellRange {
+		int ColStart;
+		int RowStart;
+		int ColCount;
+		int RowCount;
+	};
+
+	void QueryMasks(int left, int top, int right, int bottom, std::vector<int>& out) const;
+
+	void QueryMasksAt(int x, int y, std::vector<int>& out) const;
+
+	void QueryBlocks(int left, int top, int right, int bottom, std::vector<int>& out) const;
+
+	// 与矩形相交的 Cell，按行写入 out，返回其范围
+	CellRange QueryCells(int left, int top, int right, int bottom, std::vector<uint32_t>& out) const;
+
 	// Map
 
 	int GetHeight() { return m_Height; }
@@ -104,6 +182,9 @@ public:
 	int GetBlockWidth() { return m_BlockWidth; }
 	int GetBlockHeight() { return m_BlockHeight; }
 
+	// 索引（不含按需解码的像素）占用的内存
+	size_t IndexMemoryBytes() const;
+
 private:
 	struct MapHeader {
 		uint32_t		Flag;
@@ -133,10 +214,34 @@ private:
 		uint8_t A;
 	};
 
+	// 按需解码的加载状态
+	enum LoadState : uint8_t {
+		LS_LOADED = 1,
+		LS_LOADING = 2,
+	};
+
+	// 旧地图遮罩去重用的开放寻址哈希表，key 为遮罩左上角坐标
+	class MaskKeyTable {
+	public:
+		int Find(int x, int y) const;
+		void Insert(int x, int y, int id);
+		void Clear() { std::vector<uint64_t>().swap(m_Keys); std::vector<int>().swap(m_Ids); m_Count = 0; }
+
+	private:
+		static uint64_t Key(int x, int y) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y; }
+		size_t Slot(uint64_t key) const;
+
+		std::vector<uint64_t> m_Keys;
+		std::vector<int> m_Ids;  // -1 为空槽
+		size_t m_Count = 0;
+	};
+
 	int m_ScanDirection;  // 扫描方向   0：从上至下   1：从下至上
 
 	std::string m_FileName;  // 文件名
 
+	bool m_Quiet;
+
 	std::uint64_t m_FileSize;  // 文件大小
 
 	std::vector<uint8_t> m_FileData;  // 缓存数据，以释放文件句柄
@@ -157,15 +262,23 @@ private:
 
 	uint32_t m_ColCount;  // 地图块列数目
 
-	int m_CellRowCount;  // 
+	int m_CellRowCount{ 0 };  // Cell 行数，补齐到 12 的倍数
 
-	int m_CellColCount;  //
+	int m_CellColCount{ 0 };  // Cell 列数，补齐到 16 的倍数
 
 	std::vector<uint32_t> m_Cell;
 
 	uint32_t m_BlockCount;  // 地图块数量
 
-	std::vector<MapBlock> m_Blocks;  // 地图块
+	std::vector<BlockInfo> m_Blocks;  // 地图块
+
+	std::vector<uint8_t> m_BlockState;  // LoadState
+
+	std::vector<std::vector<uint8_t>> m_BlockRGB;  // 解码后的 RGB24 像素
+
+	std::vector<uint32_t> m_BlockMaskStart;  // 图块 -> 遮罩 (CSR)，大小 m_BlockCount + 1
+
+	std::vector<int> m_BlockMaskIds;
 
 	std::vector<uint32_t> m_BlockOffsets;  // 地图索引缓存
 
@@ -179,6 +292,34 @@ private:
 
 	std::vector<MaskInfo> m_Masks;  // 索引
 
+	std::vector<uint8_t> m_MaskState;  // LoadState
+
+	std::vector<std::vector<uint8_t>> m_MaskRGBA;
+
+	std::vector<std::vector<uint8_t>> m_MaskAlpha;  // 单通道 Alpha 平面，Width * Height
+
+	std::vector<uint32_t> m_MaskBlockStart;  // 遮罩 -> 图块 (CSR)，大小 m_Masks.size() + 1
+
+	std::vector<int> m_MaskBlockIds;
+
+	std::vector<uint32_t> m_MaskGridStart;  // 遮罩空间网格 (CSR)，格子与图块等大，按遮罩实际矩形划分
+
+	std::vector<int> m_MaskGridIds;
+
+	std::vector<MaskOcclusion> m_Occlusion;
+
+	std::vector<uint64_t> m_OcclusionBits;
+
+	std::vector<MaskPoly::Point> m_PolyPoints;
+
+	std::vector<uint32_t> m_PolyRingStart;  // 环 -> 顶点 (CSR)
+
+	std::vector<uint32_t> m_PolyMaskRing;   // 遮罩 -> 环，大小 m_Masks.size() + 1
+
+	PolygonStats m_PolygonStats{};
+
+	std::vector<std::pair<int, int>> m_MaskBlockPairs;  // 构造期间收集的 (图块, 遮罩)，建立 CSR 后释放
+
 	std::vector<uint32_t> m_MaskOffsets;
 
 	uint32_t m_MaskCount;
@@ -189,7 +330,14 @@ private:
 
 	void DecodeMapBlocks();
 
-	std::unordered_map<std::pair<unsigned int, unsigned int>, uint32_t, MaskKeyHash> m_NoRepeatMasks;
+	void BuildMaskRelations();
+
+	void BuildMaskGrid();
+
+	// 像素矩形对应的网格（图块）范围，返回 false 表示与地图无交集
+	bool GridRange(int left, int top, int right, int bottom, int& colStart, int& rowStart, int& colEnd, int& rowEnd) const;
+
+	MaskKeyTable m_NoRepeatMasks;
 
 	void ReadCell(uint32_t offset, uint32_t size, uint32_t index);
 
@@ -201,7 +349,16 @@ private:
 
 	void MapHandler(uint8_t* Buffer, uint32_t inSize, uint8_t* outBuffer, uint32_t* outSize);
 
-	size_t DecompressMask(void* in, void* out);
+	static size_t DecompressMask(void* in, void* out);
+
+	void DecodeMaskData(int index, std::vector<uint8_t>& out) const;
+
+	// 解码为 Alpha 平面但不写入 m_MaskAlpha，供建立索引时多线程调用；
+	// flip 同 UnpackMaskAlpha，纹理按扫描方向存放，遮挡与多边形等 CPU 计算需按地图行序（flip 为 false）
+	void DecodeMaskAlpha(int index, std::vector<uint8_t>& alpha, bool flip) const;
+
+	// 由 Alpha 平面求基线：最下方遮挡像素的下一行，没有遮挡像素时为 StartY
+	static int MaskBaseLine(const MaskInfo& mask, const uint8_t* alpha, bool flip);
 
 	RGBA ReadPixel(int x, int y);
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "maskpoly.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 方向：东、南、西、北（y 轴向下），右转为 +1
+	const int DIR_X[4] = { 1, 0, -1, 0 };
+	const int DIR_Y[4] = { 0, 1, 0, -1 };
+
+	// 在格点处选择出边：优先右转，使遮挡像素始终位于前进方向右侧且对角像素互不连通
+	int NextDirection(int dir, uint8_t edges) {
+		const int order[3] = { (dir + 1) & 3, dir, (dir + 3) & 3 };
+		for (int d : order) {
+			if (edges & (1 << d))
+				return d;
+		}
+		return -1;
+	}
+
+	float SegmentDistance(const MaskPoly::Point& p, const MaskPoly::Point& a, const MaskPoly::Point& b) {
+		float dx = b.X - a.X, dy = b.Y - a.Y;
+		float len = dx * dx + dy * dy;
+		float t = len > 0 ? std::clamp(((p.X - a.X) * dx + (p.Y - a.Y) * dy) / len, 0.f, 1.f) : 0.f;
+		float ex = a.X + t * dx - p.X, ey = a.Y + t * dy - p.Y;
+		return std::sqrt(ex * ex + ey * ey);
+	}
+}
+
+void MaskPoly::Trace(const uint8_t* alpha, int width, int height, float tolerance, Rings& out) {
+	out.Points.clear();
+	out.Start.assign(1, 0);
+	if (width <= 0 || height <= 0)
+		return;
+
+	auto covered = [&](int x, int y) {
+		return x >= 0 && y >= 0 && x < width && y < height && alpha[y * width + x] > 1;
+	};
+
+	// 每个格点的出边（bit d 对应方向 d），边的右侧为遮挡像素
+	int stride = width + 1;
+	std::vector<uint8_t> edges(stride * (height + 1), 0);
+	for (int y = 0; y <= height; y++) {
+		for (int x = 0; x < width; x++) {
+			bool above = covered(x, y - 1), below = covered(x, y);
+			if (below && !above)
+				edges[y * stride + x] |= 1 << 0;
+			else if (above && !below)
+				edges[y * stride + x + 1] |= 1 << 2;
+		}
+	}
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x <= width; x++) {
+			bool left = covered(x - 1, y), right = covered(x, y);
+			if (right && !left)
+				edges[(y + 1) * stride + x] |= 1 << 3;
+			else if (left && !right)
+				edges[y * stride + x] |= 1 << 1;
+		}
+	}
+
+	std::vector<Point> ring;
+	std::vector<uint8_t> keep;
+	for (int start = 0; start < (int)edges.size(); start++) {
+		while (edges[start]) {
+			int startDir = 0;
+			while (!(edges[start] & (1 << startDir)))
+				startDir++;
+
+			// 只记录转向处的格点，即合并共线点
+			ring.clear();
+			int x = start % stride, y = start / stride, dir = startDir;
+			edges[start] &= ~(1 << dir);
+			for (;;) {
+				x += DIR_X[dir];
+				y += DIR_Y[dir];
+				int index = y * stride + x;
+				int next;
+				if (index == start && NextDirection(dir, edges[index] | (1 << startDir)) == startDir)
+					next = startDir;
+				else
+					next = NextDirection(dir, edges[index]);
+				if (next != dir)
+					ring.push_back({ (float)x, (float)y });
+				if (index == start && next == startDir)
+					break;
+				edges[index] &= ~(1 << next);
+				dir = next;
+			}
+
+			// 闭合环的 Douglas-Peucker：以离首点最远的点切成两段分别化简
+			int n = (int)ring.size();
+			keep.assign(n + 1, 1);
+			if (tolerance > 0 && n > 3) {
+				ring.push_back(ring[0]);
+				int far = 1;
+				float farDist = 0;
+				for (int i = 1; i < n; i++) {
+					float dx = ring[i].X - ring[0].X, dy = ring[i].Y - ring[0].Y;
+					if (dx * dx + dy * dy > farDist) {
+						farDist = dx * dx + dy * dy;
+						far = i;
+					}
+				}
+				std::fill(keep.begin(), keep.end(), 0);
+				keep[0] = keep[far] = 1;
+				Simplify(ring.data(), 0, far, tolerance, keep);
+				Simplify(ring.data(), far, n, tolerance, keep);
+			}
+
+			size_t first = out.Points.size();
+			for (int i = 0; i < n; i++) {
+				if (keep[i])
+					out.Points.push_back(ring[i]);
+			}
+			if (out.Points.size() - first < 3)
+				out.Points.resize(first);
+			else
+				out.Start.push_back((uint32_t)out.Points.size());
+		}
+	}
+}
+
+void MaskPoly::Simplify(const Point* points, int first, int last, float tolerance, std::vector<uint8_t>& keep) {
+	std::vector<std::pair<int, int>> stack{ { first, last } };
+	while (!stack.empty()) {
+		auto [a, b] = stack.back();
+		stack.pop_back();
+		int index = -1;
+		float maxDist = tolerance;
+		for (int i = a + 1; i < b; i++) {
+			float dist = SegmentDistance(points[i], points[a], points[b]);
+			if (dist > maxDist) {
+				maxDist = dist;
+				index = i;
+			}
+		}
+		if (index >= 0) {
+			keep[index] = 1;
+			stack.push_back({ a, index });
+			stack.push_back({ index, b });
+		}
+	}
+}
+
+void MaskPoly::Rasterize(std::span<const Point> points, std::span<const uint32_t> start, int width, int height, uint8_t* dst) {
+	std::fill(dst, dst + width * height, 0);
+	std::vector<float> crossings;
+	for (int y = 0; y < height; y++) {
+		float cy = y + 0.5f;
+		crossings.clear();
+		for (size_t r = 0; r + 1 < start.size(); r++) {
+			uint32_t begin = start[r], end = start[r + 1];
+			for (uint32_t i = begin, j = end - 1; i < end; j = i++) {
+				const Point& a = points[i];
+				const Point& b = points[j];
+				if ((a.Y > cy) != (b.Y > cy))
+					crossings.push_back(a.X + (cy - a.Y) * (b.X - a.X) / (b.Y - a.Y));
+			}
+		}
+		std::sort(crossings.begin(), crossings.end());
+		uint8_t* row = dst + y * width;
+		for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+			int x0 = std::max(0, (int)std::ceil(crossings[i] - 0.5f));
+			int x1 = std::min(width, (int)std::ceil(crossings[i + 1] - 0.5f));
+			for (int x = x0; x < x1; x++)
+				row[x] = 1;
+		}
+	}
+}
+
+bool MaskPoly::Contains(std::span<const Point> points, std::span<const uint32_t> start, float x, float y) {
+	bool inside = false;
+	for (size_t r = 0; r + 1 < start.size(); r++) {
+		uint32_t begin = start[r], end = start[r + 1];
+		for (uint32_t i = begin, j = end - 1; i < end; j = i++) {
+			const Point& a = points[i];
+			const Point& b = points[j];
+			if ((a.Y > y) != (b.Y > y) && x < a.X + (y - a.Y) * (b.X - a.X) / (b.Y - a.Y))
+				inside = !inside;
+		}
+	}
+	return inside;
+}
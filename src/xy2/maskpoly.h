@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <span>
+
+// 遮罩矢量化：将遮挡像素（Alpha > 1）的边界追踪为闭合多边形并化简
+class MaskPoly {
+public:
+	struct Point {
+		float X;
+		float Y;
+	};
+
+	// 多边形由若干闭合环组成（外轮廓与孔洞），按奇偶规则填充
+	struct Rings {
+		std::vector<Point> Points;
+		std::vector<uint32_t> Start;  // 环 i 为 Points[Start[i] .. Start[i + 1])
+
+		size_t Count() const { return Start.empty() ? 0 : Start.size() - 1; }
+		std::span<const Point> Ring(size_t i) const { return { Points.data() + Start[i], Points.data() + Start[i + 1] }; }
+	};
+
+	// 沿像素边界（Marching Squares 的格点）追踪轮廓，顶点为像素角点坐标（相对遮罩左上角）；
+	// 对角相邻的两个像素视为不连通。tolerance 为 Douglas-Peucker 化简的最大偏差（像素），0 表示只合并共线点
+	static void Trace(const uint8_t* alpha, int width, int height, float tolerance, Rings& out);
+
+	// 按像素中心采样光栅化多边形，dst 为 width * height，覆盖处写 1
+	static void Rasterize(std::span<const Point> points, std::span<const uint32_t> start, int width, int height, uint8_t* dst);
+
+	// 奇偶规则判断点是否位于多边形内
+	static bool Contains(std::span<const Point> points, std::span<const uint32_t> start, float x, float y);
+
+private:
+	static void Simplify(const Point* points, int first, int last, float tolerance, std::vector<uint8_t>& keep);
+};
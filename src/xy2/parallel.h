@@ -0,0 +1,26 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// 将 [0, count) 交错分配给 threads 个线程并等待完成，threads 为 0 时使用硬件线程数
+template <typename F>
+void ParallelFor(size_t count, int threads, F&& fn) {
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = (int)std::min<size_t>(threads, std::max<size_t>(count, 1));
+	if (threads == 1) {
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			for (size_t i = t; i < count; i += threads)
+				fn(i);
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+}
@@ -0,0 +1,435 @@
+#include "pathfinder.h"
+#include "parallel.h"
+#include "walkgrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace {
+	const float SQRT2 = 1.41421356f;
+	const float INF = std::numeric_limits<float>::infinity();
+
+	// 8 方向，前 4 个为直行
+	const int DIR_X[8] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+	const int DIR_Y[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+	float Octile(int x0, int y0, int x1, int y1) {
+		int dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+		return (float)std::max(dx, dy) + (SQRT2 - 1) * std::min(dx, dy);
+	}
+
+	int Sign(int v) { return (v > 0) - (v < 0); }
+
+	using OpenItem = std::pair<float, int>;
+	using OpenList = std::priority_queue<OpenItem, std::vector<OpenItem>, std::greater<OpenItem>>;
+
+	// 查询用的线程局部缓存，以代数标记区分各次查询，避免每次清零
+	struct SearchScratch {
+		std::vector<float> G;
+		std::vector<int> Parent;
+		std::vector<uint32_t> Visit;   // 等于 Generation 表示本次已访问
+		std::vector<uint32_t> Closed;
+		uint32_t Generation{ 0 };
+
+		void Begin(size_t size) {
+			if (G.size() < size) {
+				G.resize(size);
+				Parent.resize(size);
+				Visit.resize(size, 0);
+				Closed.resize(size, 0);
+			}
+			if (++Generation == 0) {
+				std::fill(Visit.begin(), Visit.end(), 0);
+				std::fill(Closed.begin(), Closed.end(), 0);
+				Generation = 1;
+			}
+		}
+
+		bool Visited(int i) const { return Visit[i] == Generation; }
+		bool IsClosed(int i) const { return Closed[i] == Generation; }
+	};
+
+	thread_local SearchScratch t_AbstractScratch;
+	thread_local SearchScratch t_ClusterScratch;
+}
+
+PathFinder::PathFinder(const uint32_t* cells, int cols, int rows, int threads)
+	: m_Cols(cols), m_Rows(rows) {
+	m_ClusterCols = (cols + CLUSTER_COLS - 1) / CLUSTER_COLS;
+	m_ClusterRows = (rows + CLUSTER_ROWS - 1) / CLUSTER_ROWS;
+	int clusterCount = m_ClusterCols * m_ClusterRows;
+
+	m_Walkable.resize((size_t)cols * rows);
+	for (size_t i = 0; i < m_Walkable.size(); i++)
+		m_Walkable[i] = !WalkGrid::IsBlockedCell(cells[i]);
+
+	// 入口：相邻两簇边界上两侧都可走的连续区段，短区段取中点，长区段取两端
+	std::vector<std::vector<Point>> clusterCells(clusterCount);
+	std::vector<std::pair<Point, Point>> links;
+	auto addEntrance = [&](Point a, Point b) {
+		for (Point p : { a, b }) {
+			auto& list = clusterCells[ClusterOf(p)];
+			if (std::find(list.begin(), list.end(), p) == list.end())
+				list.push_back(p);
+		}
+		links.push_back({ a, b });
+	};
+	auto scanBorder = [&](Point a, Point b, int stepX, int stepY, int length) {
+		int runStart = -1;
+		for (int i = 0; i <= length; i++) {
+			bool open = i < length && IsWalkable(a.X + stepX * i, a.Y + stepY * i) && IsWalkable(b.X + stepX * i, b.Y + stepY * i);
+			if (open && runStart < 0)
+				runStart = i;
+			if (open || runStart < 0)
+				continue;
+			int runLength = i - runStart;
+			if (runLength < 6) {
+				int mid = runStart + runLength / 2;
+				addEntrance({ a.X + stepX * mid, a.Y + stepY * mid }, { b.X + stepX * mid, b.Y + stepY * mid });
+			} else {
+				addEntrance({ a.X + stepX * runStart, a.Y + stepY * runStart }, { b.X + stepX * runStart, b.Y + stepY * runStart });
+				addEntrance({ a.X + stepX * (i - 1), a.Y + stepY * (i - 1) }, { b.X + stepX * (i - 1), b.Y + stepY * (i - 1) });
+			}
+			runStart = -1;
+		}
+	};
+	for (int cy = 0; cy < m_ClusterRows; cy++) {
+		for (int cx = 0; cx < m_ClusterCols; cx++) {
+			Rect rect = ClusterRect(cy * m_ClusterCols + cx);
+			if (rect.Right < cols)
+				scanBorder({ rect.Right - 1, rect.Top }, { rect.Right, rect.Top }, 0, 1, rect.Bottom - rect.Top);
+			if (rect.Bottom < rows)
+				scanBorder({ rect.Left, rect.Bottom - 1 }, { rect.Left, rect.Bottom }, 1, 0, rect.Width());
+		}
+	}
+
+	m_ClusterNodeStart.assign(clusterCount + 1, 0);
+	for (int c = 0; c < clusterCount; c++) {
+		m_ClusterNodeStart[c + 1] = m_ClusterNodeStart[c] + clusterCells[c].size();
+		for (Point p : clusterCells[c])
+			m_Nodes.push_back({ p, c });
+	}
+	auto nodeOf = [&](Point p) {
+		int c = ClusterOf(p);
+		auto& list = clusterCells[c];
+		return (int)(m_ClusterNodeStart[c] + (std::find(list.begin(), list.end(), p) - list.begin()));
+	};
+
+	// 簇内边：每个入口在簇内做一次 Dijkstra
+	std::vector<std::vector<std::pair<int, Edge>>> clusterEdges(clusterCount);
+	ParallelFor(clusterCount, threads, [&](size_t c) {
+		Rect rect = ClusterRect(c);
+		std::vector<float> dist;
+		for (uint32_t i = m_ClusterNodeStart[c]; i < m_ClusterNodeStart[c + 1]; i++) {
+			ClusterDijkstra(rect, m_Nodes[i].Cell, dist);
+			for (uint32_t j = m_ClusterNodeStart[c]; j < m_ClusterNodeStart[c + 1]; j++) {
+				Point p = m_Nodes[j].Cell;
+				float d = dist[(p.Y - rect.Top) * rect.Width() + p.X - rect.Left];
+				if (i != j && d < INF)
+					clusterEdges[c].push_back({ (int)i, { (int)j, d } });
+			}
+		}
+	});
+
+	std::vector<std::pair<int, Edge>> edges;
+	for (auto& list : clusterEdges)
+		edges.insert(edges.end(), list.begin(), list.end());
+	for (auto& [a, b] : links) {
+		int na = nodeOf(a), nb = nodeOf(b);
+		edges.push_back({ na, { nb, 1.f } });
+		edges.push_back({ nb, { na, 1.f } });
+	}
+	m_EdgeStart.assign(m_Nodes.size() + 1, 0);
+	for (auto& e : edges)
+		m_EdgeStart[e.first + 1]++;
+	for (size_t i = 0; i < m_Nodes.size(); i++)
+		m_EdgeStart[i + 1] += m_EdgeStart[i];
+	m_Edges.resize(edges.size());
+	std::vector<uint32_t> cursor(m_EdgeStart.begin(), m_EdgeStart.end() - 1);
+	for (auto& e : edges)
+		m_Edges[cursor[e.first]++] = e.second;
+}
+
+PathFinder::Rect PathFinder::ClusterRect(int cluster) const {
+	int cx = cluster % m_ClusterCols, cy = cluster / m_ClusterCols;
+	return { cx * CLUSTER_COLS, cy * CLUSTER_ROWS, std::min((cx + 1) * CLUSTER_COLS, m_Cols), std::min((cy + 1) * CLUSTER_ROWS, m_Rows) };
+}
+
+size_t PathFinder::MemoryBytes() const {
+	return m_Walkable.capacity()
+		+ m_Nodes.capacity() * sizeof(Node)
+		+ (m_ClusterNodeStart.capacity() + m_EdgeStart.capacity()) * sizeof(uint32_t)
+		+ m_Edges.capacity() * sizeof(Edge);
+}
+
+void PathFinder::ClusterDijkstra(const Rect& rect, Point from, std::vector<float>& dist) const {
+	int width = rect.Width();
+	dist.assign(width * (rect.Bottom - rect.Top), INF);
+	if (!IsWalkable(rect, from.X, from.Y))
+		return;
+
+	OpenList open;
+	int start = (from.Y - rect.Top) * width + from.X - rect.Left;
+	dist[start] = 0;
+	open.push({ 0.f, start });
+	while (!open.empty()) {
+		auto [d, i] = open.top();
+		open.pop();
+		if (d > dist[i])
+			continue;
+		int x = rect.Left + i % width, y = rect.Top + i / width;
+		for (int k = 0; k < 8; k++) {
+			int nx = x + DIR_X[k], ny = y + DIR_Y[k];
+			if (!IsWalkable(rect, nx, ny))
+				continue;
+			if (k >= 4 && !(IsWalkable(rect, nx, y) && IsWalkable(rect, x, ny)))
+				continue;
+			int n = (ny - rect.Top) * width + nx - rect.Left;
+			float nd = d + (k < 4 ? 1.f : SQRT2);
+			if (nd < dist[n]) {
+				dist[n] = nd;
+				open.push({ nd, n });
+			}
+		}
+	}
+}
+
+bool PathFinder::Jump(const Rect& rect, int x, int y, int dx, int dy, Point goal, Point& jumpPoint) const {
+	for (;;) {
+		if (!IsWalkable(rect, x, y))
+			return false;
+		if (x == goal.X && y == goal.Y) {
+			jumpPoint = { x, y };
+			return true;
+		}
+		if (dx && dy) {
+			Point unused;
+			if (Jump(rect, x + dx, y, dx, 0, goal, unused) || Jump(rect, x, y + dy, 0, dy, goal, unused)) {
+				jumpPoint = { x, y };
+				return true;
+			}
+			if (!(IsWalkable(rect, x + dx, y) && IsWalkable(rect, x, y + dy)))
+				return false;
+		} else if (dx) {
+			// 不穿角时，侧面格只能从当前格进入则为强制邻居
+			if ((IsWalkable(rect, x, y - 1) && !IsWalkable(rect, x - dx, y - 1)) || (IsWalkable(rect, x, y + 1) && !IsWalkable(rect, x - dx, y + 1))) {
+				jumpPoint = { x, y };
+				return true;
+			}
+		} else {
+			if ((IsWalkable(rect, x - 1, y) && !IsWalkable(rect, x - 1, y - dy)) || (IsWalkable(rect, x + 1, y) && !IsWalkable(rect, x + 1, y - dy))) {
+				jumpPoint = { x, y };
+				return true;
+			}
+		}
+		x += dx;
+		y += dy;
+	}
+}
+
+bool PathFinder::ClusterJPS(const Rect& rect, Point start, Point goal, std::vector<Point>& path) const {
+	if (!IsWalkable(rect, start.X, start.Y) || !IsWalkable(rect, goal.X, goal.Y))
+		return false;
+
+	int width = rect.Width();
+	auto index = [&](Point p) { return (p.Y - rect.Top) * width + p.X - rect.Left; };
+	auto point = [&](int i) { return Point{ rect.Left + i % width, rect.Top + i / width }; };
+
+	SearchScratch& s = t_ClusterScratch;
+	s.Begin(width * (rect.Bottom - rect.Top));
+	OpenList open;
+	int startIndex = index(start), goalIndex = index(goal);
+	s.G[startIndex] = 0;
+	s.Parent[startIndex] = -1;
+	s.Visit[startIndex] = s.Generation;
+	open.push({ Octile(start.X, start.Y, goal.X, goal.Y), startIndex });
+
+	int neighbors[8][2];
+	while (!open.empty()) {
+		int current = open.top().second;
+		open.pop();
+		if (s.IsClosed(current))
+			continue;
+		s.Closed[current] = s.Generation;
+		if (current == goalIndex)
+			break;
+
+		// 按来向裁剪邻居
+		Point p = point(current);
+		int count = 0;
+		auto add = [&](int dx, int dy) {
+			neighbors[count][0] = dx;
+			neighbors[count][1] = dy;
+			count++;
+		};
+		if (s.Parent[current] < 0) {
+			for (int k = 0; k < 8; k++) {
+				if (k < 4 || (IsWalkable(rect, p.X + DIR_X[k], p.Y) && IsWalkable(rect, p.X, p.Y + DIR_Y[k])))
+					add(DIR_X[k], DIR_Y[k]);
+			}
+		} else {
+			Point from = point(s.Parent[current]);
+			int dx = Sign(p.X - from.X), dy = Sign(p.Y - from.Y);
+			if (dx && dy) {
+				bool horizontal = IsWalkable(rect, p.X + dx, p.Y), vertical = IsWalkable(rect, p.X, p.Y + dy);
+				if (vertical)
+					add(0, dy);
+				if (horizontal)
+					add(dx, 0);
+				if (horizontal && vertical)
+					add(dx, dy);
+			} else if (dx) {
+				bool next = IsWalkable(rect, p.X + dx, p.Y);
+				bool up = IsWalkable(rect, p.X, p.Y - 1), down = IsWalkable(rect, p.X, p.Y + 1);
+				if (next) {
+					add(dx, 0);
+					if (up)
+						add(dx, -1);
+					if (down)
+						add(dx, 1);
+				}
+				if (up)
+					add(0, -1);
+				if (down)
+					add(0, 1);
+			} else {
+				bool next = IsWalkable(rect, p.X, p.Y + dy);
+				bool left = IsWalkable(rect, p.X - 1, p.Y), right = IsWalkable(rect, p.X + 1, p.Y);
+				if (next) {
+					add(0, dy);
+					if (left)
+						add(-1, dy);
+					if (right)
+						add(1, dy);
+				}
+				if (left)
+					add(-1, 0);
+				if (right)
+					add(1, 0);
+			}
+		}
+
+		for (int k = 0; k < count; k++) {
+			Point jumpPoint;
+			if (!Jump(rect, p.X + neighbors[k][0], p.Y + neighbors[k][1], neighbors[k][0], neighbors[k][1], goal, jumpPoint))
+				continue;
+			int next = index(jumpPoint);
+			if (s.IsClosed(next))
+				continue;
+			float g = s.G[current] + Octile(p.X, p.Y, jumpPoint.X, jumpPoint.Y);
+			if (!s.Visited(next) || g < s.G[next]) {
+				s.G[next] = g;
+				s.Parent[next] = current;
+				s.Visit[next] = s.Generation;
+				open.push({ g + Octile(jumpPoint.X, jumpPoint.Y, goal.X, goal.Y), next });
+			}
+		}
+	}
+	if (!s.IsClosed(goalIndex))
+		return false;
+
+	// 跳点之间为直线或 45° 斜线，逐格展开
+	std::vector<Point> jumpPoints;
+	for (int i = goalIndex; i >= 0; i = s.Parent[i])
+		jumpPoints.push_back(point(i));
+	for (size_t i = jumpPoints.size() - 1; i > 0; i--) {
+		Point a = jumpPoints[i], b = jumpPoints[i - 1];
+		int dx = Sign(b.X - a.X), dy = Sign(b.Y - a.Y);
+		while (!(a == b)) {
+			a.X += dx;
+			a.Y += dy;
+			path.push_back(a);
+		}
+	}
+	return true;
+}
+
+bool PathFinder::Find(Point start, Point goal, std::vector<Point>& path) const {
+	path.clear();
+	if (!IsWalkable(start.X, start.Y) || !IsWalkable(goal.X, goal.Y))
+		return false;
+	path.push_back(start);
+	if (start == goal)
+		return true;
+
+	int startCluster = ClusterOf(start), goalCluster = ClusterOf(goal);
+	Rect startRect = ClusterRect(startCluster), goalRect = ClusterRect(goalCluster);
+	if (startCluster == goalCluster && ClusterJPS(startRect, start, goal, path))
+		return true;
+
+	// 起点与终点作为临时节点，只在本次查询中与所在簇的入口相连
+	std::vector<float> dist;
+	std::vector<std::pair<int, float>> startLinks, goalLinks;
+	ClusterDijkstra(startRect, start, dist);
+	for (uint32_t i = m_ClusterNodeStart[startCluster]; i < m_ClusterNodeStart[startCluster + 1]; i++) {
+		Point p = m_Nodes[i].Cell;
+		float d = dist[(p.Y - startRect.Top) * startRect.Width() + p.X - startRect.Left];
+		if (d < INF)
+			startLinks.push_back({ (int)i, d });
+	}
+	ClusterDijkstra(goalRect, goal, dist);
+	for (uint32_t i = m_ClusterNodeStart[goalCluster]; i < m_ClusterNodeStart[goalCluster + 1]; i++) {
+		Point p = m_Nodes[i].Cell;
+		float d = dist[(p.Y - goalRect.Top) * goalRect.Width() + p.X - goalRect.Left];
+		if (d < INF)
+			goalLinks.push_back({ (int)i, d });
+	}
+	if (startLinks.empty() || goalLinks.empty())
+		return false;
+
+	// 抽象图 A*，下标 m_Nodes.size() 为终点
+	int goalNode = m_Nodes.size();
+	SearchScratch& s = t_AbstractScratch;
+	s.Begin(m_Nodes.size() + 1);
+	OpenList open;
+	auto relax = [&](int node, int parent, float g) {
+		if (s.IsClosed(node) || (s.Visited(node) && g >= s.G[node]))
+			return;
+		s.G[node] = g;
+		s.Parent[node] = parent;
+		s.Visit[node] = s.Generation;
+		Point p = node == goalNode ? goal : m_Nodes[node].Cell;
+		open.push({ g + Octile(p.X, p.Y, goal.X, goal.Y), node });
+	};
+	for (auto [node, d] : startLinks)
+		relax(node, -1, d);
+	while (!open.empty()) {
+		int current = open.top().second;
+		open.pop();
+		if (s.IsClosed(current))
+			continue;
+		s.Closed[current] = s.Generation;
+		if (current == goalNode)
+			break;
+		for (auto [node, d] : goalLinks) {
+			if (node == current)
+				relax(goalNode, current, s.G[current] + d);
+		}
+		for (uint32_t e = m_EdgeStart[current]; e < m_EdgeStart[current + 1]; e++)
+			relax(m_Edges[e].To, current, s.G[current] + m_Edges[e].Cost);
+	}
+	if (!s.IsClosed(goalNode))
+		return false;
+
+	// 细化：同簇相邻节点之间用 JPS，跨簇边为一步
+	std::vector<int> nodes;
+	for (int i = s.Parent[goalNode]; i >= 0; i = s.Parent[i])
+		nodes.push_back(i);
+	std::reverse(nodes.begin(), nodes.end());
+	Point current = start;
+	int currentCluster = startCluster;
+	for (int node : nodes) {
+		const Node& next = m_Nodes[node];
+		if (next.Cluster == currentCluster) {
+			if (!(current == next.Cell) && !ClusterJPS(ClusterRect(currentCluster), current, next.Cell, path))
+				return false;
+		} else
+			path.push_back(next.Cell);
+		current = next.Cell;
+		currentCluster = next.Cluster;
+	}
+	if (!(current == goal) && !ClusterJPS(goalRect, current, goal, path))
+		return false;
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 基于 Cell 网格的分层寻路（HPA*）：以一个图块的 16 x 12 个 Cell 为一簇，预先计算簇边界上的入口
+// 以及同簇入口之间的代价；查询时在入口构成的抽象图上做 A*，再在簇内用 JPS 细化为逐格路径。
+// 8 方向移动，直行代价 1，斜行代价 √2，斜行时两侧的直行格都须可走（不穿角）。
+// 构造完成后只读，Find 可在多线程中并发调用。
+class PathFinder {
+public:
+	static const int CLUSTER_COLS = 16;
+	static const int CLUSTER_ROWS = 12;
+
+	struct Point {
+		int X;  // Cell 列
+		int Y;  // Cell 行
+
+		bool operator==(const Point& other) const { return X == other.X && Y == other.Y; }
+	};
+
+	// cells 为 MapX::GetCell() 的 Cell 数组，threads 为 0 时使用硬件线程数预计算
+	PathFinder(const uint32_t* cells, int cols, int rows, int threads = 0);
+
+	bool IsWalkable(int x, int y) const { return x >= 0 && y >= 0 && x < m_Cols && y < m_Rows && m_Walkable[y * m_Cols + x]; }
+
+	// 成功时 path 为从 start 到 goal（含首尾）的逐格路径
+	bool Find(Point start, Point goal, std::vector<Point>& path) const;
+
+	int GetCols() const { return m_Cols; }
+	int GetRows() const { return m_Rows; }
+	size_t GetNodeCount() const { return m_Nodes.size(); }
+	size_t GetEdgeCount() const { return m_Edges.size(); }
+
+	// 网格与抽象图占用的内存（不含查询时的线程局部缓存）
+	size_t MemoryBytes() const;
+
+private:
+	struct Node {
+		Point Cell;
+		int Cluster;
+	};
+
+	struct Edge {
+		int To;
+		float Cost;
+	};
+
+	// 左闭右开
+	struct Rect {
+		int Left;
+		int Top;
+		int Right;
+		int Bottom;
+
+		int Width() const { return Right - Left; }
+		bool Contains(int x, int y) const { return x >= Left && y >= Top && x < Right && y < Bottom; }
+	};
+
+	Rect ClusterRect(int cluster) const;
+
+	int ClusterOf(Point p) const { return (p.Y / CLUSTER_ROWS) * m_ClusterCols + p.X / CLUSTER_COLS; }
+
+	bool IsWalkable(const Rect& rect, int x, int y) const { return rect.Contains(x, y) && m_Walkable[y * m_Cols + x]; }
+
+	// 簇内 Dijkstra，dist 为 rect 内各格到 from 的代价，不可达为无穷大
+	void ClusterDijkstra(const Rect& rect, Point from, std::vector<float>& dist) const;
+
+	// 簇内 JPS，成功时向 path 追加不含 start 的逐格路径
+	bool ClusterJPS(const Rect& rect, Point start, Point goal, std::vector<Point>& path) const;
+
+	bool Jump(const Rect& rect, int x, int y, int dx, int dy, Point goal, Point& jumpPoint) const;
+
+	int m_Cols;
+	int m_Rows;
+	int m_ClusterCols;
+	int m_ClusterRows;
+
+	std::vector<uint8_t> m_Walkable;
+
+	std::vector<Node> m_Nodes;  // 入口节点，按簇排序
+
+	std::vector<uint32_t> m_ClusterNodeStart;  // 簇 -> 节点 (CSR)
+
+	std::vector<uint32_t> m_EdgeStart;  // 节点 -> 边 (CSR)，含簇内边与跨簇边
+
+	std::vector<Edge> m_Edges;
+};
@@ -0,0 +1,59 @@
+#ifndef SHELFPACK_H
+#define SHELFPACK_H
+#include <vector>
+
+// 货架式矩形装箱：按行（货架）摆放，优先选择高度最贴合的货架
+class ShelfPacker {
+public:
+    ShelfPacker(int width = 0, int height = 0, int padding = 1)
+        : m_width(width), m_height(height), m_padding(padding) {
+    }
+
+    bool pack(int width, int height, int &x, int &y) {
+        int w = width + m_padding;
+        int h = height + m_padding;
+        if (w > m_width || h > m_height)
+            return false;
+
+        Shelf *best = nullptr;
+        for (auto &shelf: m_shelves) {
+            if (shelf.height >= h && m_width - shelf.x >= w && (!best || shelf.height < best->height))
+                best = &shelf;
+        }
+        if (!best) {
+            if (m_usedHeight + h > m_height)
+                return false;
+            m_shelves.push_back({m_usedHeight, h, 0});
+            m_usedHeight += h;
+            best = &m_shelves.back();
+        }
+        x = best->x;
+        y = best->y;
+        best->x += w;
+        return true;
+    }
+
+    void reset() {
+        m_shelves.clear();
+        m_usedHeight = 0;
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int usedHeight() const { return m_usedHeight; }
+
+private:
+    struct Shelf {
+        int y;
+        int height;
+        int x;
+    };
+
+    int m_width;
+    int m_height;
+    int m_padding;
+    int m_usedHeight{0};
+    std::vector<Shelf> m_shelves;
+};
+
+#endif //SHELFPACK_H
@@ -0,0 +1,169 @@
+#include "walkgrid.h"
+#include "mapx.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+	using RawTile = std::array<uint64_t, WalkGrid::TILE_WORDS>;
+
+	struct RawTileHash {
+		size_t operator()(const RawTile& tile) const {
+			uint64_t h = 0x9e3779b97f4a7c15ull;
+			for (uint64_t word : tile) {
+				h ^= word + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			}
+			return (size_t)h;
+		}
+	};
+}
+
+std::vector<uint8_t> WalkGrid::Encode(const uint32_t* cells, int cellCols, int cellRows) {
+	Header header{};
+	header.Magic = MAGIC;
+	header.Version = VERSION;
+	header.HeaderSize = sizeof(Header);
+	header.CellCols = cellCols;
+	header.CellRows = cellRows;
+	header.TileCols = (cellCols + TILE_COLS - 1) / TILE_COLS;
+	header.TileRows = (cellRows + TILE_ROWS - 1) / TILE_ROWS;
+
+	// 地图边缘不足一个瓦片的部分按阻挡填充
+	std::vector<uint32_t> tiles(header.TileCols * header.TileRows);
+	std::vector<RawTile> rawTiles;
+	std::unordered_map<RawTile, uint32_t, RawTileHash> rawIndex;
+	for (uint32_t tileRow = 0; tileRow < header.TileRows; tileRow++) {
+		for (uint32_t tileCol = 0; tileCol < header.TileCols; tileCol++) {
+			RawTile raw{};
+			int blocked = 0;
+			for (int r = 0; r < TILE_ROWS; r++) {
+				for (int c = 0; c < TILE_COLS; c++) {
+					int col = tileCol * TILE_COLS + c, row = tileRow * TILE_ROWS + r;
+					if (col >= cellCols || row >= cellRows || IsBlockedCell(cells[row * cellCols + col])) {
+						int bit = r * TILE_COLS + c;
+						raw[bit >> 6] |= 1ull << (bit & 63);
+						blocked++;
+					}
+				}
+			}
+
+			uint32_t& tile = tiles[tileRow * header.TileCols + tileCol];
+			if (blocked == 0)
+				tile = 0;
+			else if (blocked == TILE_COLS * TILE_ROWS)
+				tile = 1;
+			else {
+				auto [it, inserted] = rawIndex.try_emplace(raw, (uint32_t)rawTiles.size());
+				if (inserted)
+					rawTiles.push_back(raw);
+				tile = it->second + 2;
+			}
+		}
+	}
+
+	header.RawTileCount = rawTiles.size();
+	header.RawTileOffset = (sizeof(Header) + tiles.size() * sizeof(uint32_t) + 7) & ~7u;
+
+	std::vector<uint8_t> out(header.RawTileOffset + rawTiles.size() * sizeof(RawTile), 0);
+	memcpy(out.data(), &header, sizeof(Header));
+	memcpy(out.data() + sizeof(Header), tiles.data(), tiles.size() * sizeof(uint32_t));
+	if (!rawTiles.empty())
+		memcpy(out.data() + header.RawTileOffset, rawTiles.data(), rawTiles.size() * sizeof(RawTile));
+	return out;
+}
+
+bool WalkGrid::Export(const std::string& mapFile, const std::string& outFile, bool quiet) {
+	MapX map(mapFile, 0, quiet);
+	if (map.GetCellColCount() <= 0 || map.GetCellRowCount() <= 0)
+		return false;
+
+	auto data = Encode(map.GetCell(), map.GetCellColCount(), map.GetCellRowCount());
+	std::ofstream fs(outFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fs) {
+		if (!quiet)
+			std::cerr << "WalkGrid write error! " << outFile << std::endl;
+		return false;
+	}
+	fs.write((const char*)data.data(), data.size());
+	return (bool)fs;
+}
+
+int WalkGrid::ExportDirectory(const std::string& mapDir, const std::string& outDir, int threads, ExportProgress* progress) {
+	std::vector<std::filesystem::path> maps;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(mapDir, ec)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".map")
+			maps.push_back(entry.path());
+	}
+	std::filesystem::create_directories(outDir, ec);
+	if (progress)
+		progress->Total = (int)maps.size();
+
+	// 地图大小差异较大，按原子计数逐个领取
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = (int)std::min<size_t>(threads, std::max<size_t>(maps.size(), 1));
+	std::atomic<size_t> next{ 0 };
+	std::atomic<int> succeeded{ 0 };
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&]() {
+			for (size_t i = next++; i < maps.size(); i = next++) {
+				auto outFile = std::filesystem::path(outDir) / maps[i].stem();
+				outFile += ".wg";
+				// 多线程导出时不逐个输出，结束后只打印一行汇总
+				if (Export(maps[i].string(), outFile.string(), true))
+					succeeded++;
+				if (progress)
+					progress->Done++;
+			}
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+
+	std::clog << "WalkGrid exported " << succeeded << "/" << maps.size() << " maps to " << outDir << std::endl;
+	return succeeded;
+}
+
+bool WalkGrid::Open(const std::string& file) {
+	m_Header = nullptr;
+	if (!m_File.open(file))
+		return false;
+	return Load(m_File.bytes());
+}
+
+bool WalkGrid::Load(std::span<const uint8_t> data) {
+	m_Header = nullptr;
+	if (data.size() < sizeof(Header) || (uintptr_t)data.data() % 8 != 0)
+		return false;
+
+	const Header* header = (const Header*)data.data();
+	if (header->Magic != MAGIC || header->Version != VERSION || header->HeaderSize != sizeof(Header))
+		return false;
+	if (header->TileCols != (header->CellCols + TILE_COLS - 1) / TILE_COLS || header->TileRows != (header->CellRows + TILE_ROWS - 1) / TILE_ROWS)
+		return false;
+
+	size_t tileCount = (size_t)header->TileCols * header->TileRows;
+	if (header->RawTileOffset % 8 != 0 || header->RawTileOffset < sizeof(Header) + tileCount * sizeof(uint32_t)
+		|| header->RawTileOffset + (size_t)header->RawTileCount * TILE_WORDS * sizeof(uint64_t) > data.size())
+		return false;
+
+	const uint32_t* tiles = (const uint32_t*)(data.data() + sizeof(Header));
+	for (size_t i = 0; i < tileCount; i++) {
+		if (tiles[i] >= header->RawTileCount + 2)
+			return false;
+	}
+
+	m_Data = data;
+	m_Header = header;
+	m_Tiles = tiles;
+	m_RawTiles = (const uint64_t*)(data.data() + header->RawTileOffset);
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+
+// 服务端用的可行走网格：Cell 按图块划分为 16 x 12 的瓦片，整块可走/整块阻挡的瓦片只记类型，
+// 其余瓦片以每 Cell 1bit 存储并去重。文件可整体 mmap 后直接查询，无需解码。
+//
+// 文件格式（小端）：
+//   Header
+//   uint32_t Tiles[TileCols * TileRows]   0 = 整块可走，1 = 整块阻挡，n >= 2 为 RawTiles[n - 2]
+//   uint64_t RawTiles[RawTileCount][3]    第 r 行第 c 列 Cell 为 bit (r * 16 + c)，1 表示阻挡
+class WalkGrid {
+public:
+	static const uint32_t MAGIC = 'X' | 'Y' << 8 | 'W' << 16 | 'G' << 24;  // "XYWG"
+	static const uint16_t VERSION = 1;
+	static const int TILE_COLS = 16;
+	static const int TILE_ROWS = 12;
+	static const int TILE_WORDS = 3;  // 16 * 12 bit
+
+	struct Header {
+		uint32_t Magic;
+		uint16_t Version;
+		uint16_t HeaderSize;
+		uint32_t CellCols;
+		uint32_t CellRows;
+		uint32_t TileCols;
+		uint32_t TileRows;
+		uint32_t RawTileCount;
+		uint32_t RawTileOffset;  // RawTiles 的文件偏移，按 8 字节对齐
+	};
+
+	// Cell 值为 1 表示阻挡，其余可走
+	static bool IsBlockedCell(uint32_t cell) { return cell == 1; }
+
+	// 由 MapX::GetCell() 的 Cell 数组编码为文件内容
+	static std::vector<uint8_t> Encode(const uint32_t* cells, int cellCols, int cellRows);
+
+	// 读取地图并写出网格文件，quiet 为 true 时不输出任何信息
+	static bool Export(const std::string& mapFile, const std::string& outFile, bool quiet = false);
+
+	// 导出进度，可在其他线程读取
+	struct ExportProgress {
+		std::atomic<int> Total{ 0 };
+		std::atomic<int> Done{ 0 };
+	};
+
+	// 并行导出目录下全部 .map 文件到 outDir/<文件名>.wg，threads 为 0 时使用硬件线程数，返回成功数量
+	static int ExportDirectory(const std::string& mapDir, const std::string& outDir, int threads = 0, ExportProgress* progress = nullptr);
+
+	// 映射网格文件，成功后查询直接读取映射内存
+	bool Open(const std::string& file);
+
+	// 使用外部内存（须保持有效且 8 字节对齐）
+	bool Load(std::span<const uint8_t> data);
+
+	bool IsOpen() const { return m_Header != nullptr; }
+
+	int GetCellCols() const { return m_Header ? m_Header->CellCols : 0; }
+	int GetCellRows() const { return m_Header ? m_Header->CellRows : 0; }
+
+	// 未打开或越界视为不可走
+	bool IsWalkable(int col, int row) const {
+		if (!m_Header || col < 0 || row < 0 || col >= (int)m_Header->CellCols || row >= (int)m_Header->CellRows)
+			return false;
+		uint32_t tile = m_Tiles[(row / TILE_ROWS) * m_Header->TileCols + col / TILE_COLS];
+		if (tile < 2)
+			return tile == 0;
+		uint32_t bit = (row % TILE_ROWS) * TILE_COLS + col % TILE_COLS;
+		return !((m_RawTiles[(tile - 2) * TILE_WORDS + (bit >> 6)] >> (bit & 63)) & 1);
+	}
+
+	// 文件（映射内存）大小
+	size_t MemoryBytes() const { return m_Data.size(); }
+
+private:
+	MappedFile m_File;
+	std::span<const uint8_t> m_Data;
+	const Header* m_Header{ nullptr };
+	const uint32_t* m_Tiles{ nullptr };
+	const uint64_t* m_RawTiles{ nullptr };
+};
@@ -1,223 +1,404 @@
 #include "was.h"
 
-#include <fstream>
-#include <iostream>
-#include <vector>
-
-Was::Was(const std::string &path, const WasInfo &info) {
-    std::fstream file(path, std::ios::binary | std::ios::in);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file " << path << std::endl;
-        return;
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include "shelfpack.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WAS_USE_AVX2 1
+#else
+#define WAS_USE_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAS_USE_SSE2 1
+#else
+#define WAS_USE_SSE2 0
+#endif
+
+namespace {
+    // 帧头依次为 x、y、width、height
+    const size_t FRAME_HEAD_SIZE = 16;
+
+    // 帧数据副本前后补零的字节数：行首会检查前一个字节，一个数据段最多连续读取 64 字节
+    const size_t SCRATCH_FRONT = 1;
+    const size_t SCRATCH_BACK = 64;
+
+    // 单帧像素数上限，超出视为数据损坏
+    const uint64_t MAX_FRAME_PIXELS = 1 << 24;
+
+    // 索引模式的"调色板"：索引原样输出
+    struct IndexPalette {
+        IndexedPixel value[256];
+
+        constexpr IndexPalette() : value() {
+            for (int i = 0; i < 256; i++)
+                value[i] = {(uint8_t) i, 255};
+        }
+    };
+
+    constexpr IndexPalette INDEX_PALETTE;
+
+    // 5、6 位颜色分量扩展到 8 位
+    struct Expand565 {
+        uint8_t five[32];
+        uint8_t six[64];
+
+        constexpr Expand565() : five(), six() {
+            for (int i = 0; i < 32; i++)
+                five[i] = (uint8_t) (i << 3 | i >> 2);
+            for (int i = 0; i < 64; i++)
+                six[i] = (uint8_t) (i << 2 | i >> 4);
+        }
+    };
+
+    constexpr Expand565 EXPAND_565;
+
+    template <bool Premultiply>
+    RGBA withAlpha(RGBA color, uint8_t alpha) {
+        if constexpr (Premultiply) {
+            color.R = (uint8_t) ((color.R * alpha + 127) / 255);
+            color.G = (uint8_t) ((color.G * alpha + 127) / 255);
+            color.B = (uint8_t) ((color.B * alpha + 127) / 255);
+        }
+        color.A = alpha;
+        return color;
     }
 
-    file.seekg(info.offset, std::ios::beg);
-    file.read((char *) &m_header, sizeof(m_header));
+    template <bool Premultiply>
+    IndexedPixel withAlpha(IndexedPixel pixel, uint8_t alpha) {
+        pixel.A = alpha;
+        return pixel;
+    }
 
+    // 一段相同像素：RGBA 每次写 4 个
+    template <class Pixel>
+    void fillPixels(Pixel *out, int64_t count, Pixel pixel) {
+        int64_t i = 0;
+#if WAS_USE_SSE2
+        if constexpr (sizeof(Pixel) == 4) {
+            uint32_t value;
+            memcpy(&value, &pixel, sizeof(value));
+            __m128i v = _mm_set1_epi32((int) value);
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128((__m128i *) (out + i), v);
+        }
+#endif
+        for (; i < count; i++)
+            out[i] = pixel;
+    }
+
+    // 一段调色板索引查表展开：AVX2 下每次取 8 个索引 gather
+    template <class Pixel>
+    void expandPixels(Pixel *out, const uint8_t *indices, int64_t count, const Pixel *palette) {
+        int64_t i = 0;
+#if WAS_USE_AVX2
+        if constexpr (sizeof(Pixel) == 4) {
+            for (; i + 8 <= count; i += 8) {
+                __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (indices + i)));
+                _mm256_storeu_si256((__m256i *) (out + i), _mm256_i32gather_epi32((const int *) palette, index, 4));
+            }
+        }
+#endif
+        for (; i < count; i++)
+            out[i] = palette[indices[i]];
+    }
+
+    template <class T>
+    bool readValue(std::span<const uint8_t> data, size_t offset, T &value) {
+        if (offset > data.size() || data.size() - offset < sizeof(T))
+            return false;
+        memcpy(&value, data.data() + offset, sizeof(T));
+        return true;
+    }
+}
+
+Was::Was(std::span<const uint8_t> data, WasPixelFormat format, size_t cacheBytes)
+    : m_format(format), m_cacheBytes(cacheBytes) {
+    if (!readValue(data, 0, m_header) || m_header.headSize < 12 || m_header.directionNum < 0 || m_header.frameNum < 0
+        || m_header.width < 0 || m_header.height < 0)
+        return;
+
+    size_t offset = sizeof(m_header);
     if (m_header.headSize > 12) {
         m_times.resize(m_header.headSize - 12);
-        file.read((char *) m_times.data(), m_times.size());
+        if (data.size() - offset < m_times.size())
+            return;
+        memcpy(m_times.data(), data.data() + offset, m_times.size());
     }
 
-    std::vector<RGBA> palette(256);
-    for (int i = 0; i < 256; ++i) {
-        uint16_t rgb565;
-        file.read((char *) &rgb565, sizeof(rgb565));
-        RGB565ToRGBA8888(rgb565, 255, palette[i]);
-    }
+    offset = 4 + m_header.headSize;
+    uint16_t rgb565[256];
+    if (!readValue(data, offset, rgb565))
+        return;
+    for (int i = 0; i < 256; ++i)
+        RGB565ToRGBA8888(rgb565[i], 255, m_palette[i]);
+    offset += sizeof(rgb565);
 
     int picNum = m_header.directionNum * m_header.frameNum;
-    std::vector<uint32_t> picOffsets(picNum);
-    for (int i = 0; i < picNum; ++i) {
-        uint32_t offset;
-        file.read((char *) &offset, sizeof(uint32_t));
-        picOffsets[i] = offset + info.offset + 4 + m_header.headSize;
+    if ((data.size() - offset) / sizeof(uint32_t) < (size_t) picNum)
+        return;
+    const uint8_t *picOffsets = data.data() + offset;
+    size_t frameBase = 4 + m_header.headSize;
+
+    // 只读帧头，像素留到 frame() 时解码
+    m_frames.resize(picNum);
+    for (int index = 0; index < picNum; ++index) {
+        uint32_t begin, end = 0;
+        memcpy(&begin, picOffsets + index * sizeof(uint32_t), sizeof(uint32_t));
+        if (index < picNum - 1)
+            memcpy(&end, picOffsets + (index + 1) * sizeof(uint32_t), sizeof(uint32_t));
+        size_t frameBegin = frameBase + begin;
+        size_t frameEnd = end > begin ? std::min(frameBase + end, data.size()) : data.size();
+        if (frameBegin + FRAME_HEAD_SIZE > frameEnd)
+            continue;
+
+        auto &frame = m_frames[index].frame;
+        auto frameBytes = data.subspan(frameBegin, frameEnd - frameBegin);
+        readValue(frameBytes, 0, frame.x);
+        readValue(frameBytes, 4, frame.y);
+        readValue(frameBytes, 8, frame.width);
+        readValue(frameBytes, 12, frame.height);
+        if ((uint64_t) frame.width * frame.height > MAX_FRAME_PIXELS
+            || (frameBytes.size() - FRAME_HEAD_SIZE) / sizeof(uint32_t) < frame.height) {
+            frame = {};
+            continue;
+        }
+        m_frames[index].data = frameBytes;
     }
 
-    m_fullFrames.resize(m_header.directionNum);
-    m_pixels.resize(m_header.width * m_header.frameNum * m_header.height * m_header.directionNum * 2);
-
-    for (int i = 0; i < m_header.directionNum; ++i) {
-        m_fullFrames[i].resize(m_header.frameNum);
-        for (int j = 0; j < m_header.frameNum; ++j) {
-            int index = i * m_header.frameNum + j;
-            int frameSize = index < picNum - 1
-                                ? picOffsets[index + 1] - picOffsets[index]
-                                : info.size + info.offset - picOffsets[index];
-            file.seekg(picOffsets[index], std::ios::beg);
-            std::vector<uint8_t> buf(frameSize);
-            file.read((char *) buf.data(), frameSize);
-            auto &frame = m_fullFrames[i][j];
-            readFrame(buf, palette, frame);
-
-            // for (int r = 0; r < frame.height; ++r) {
-            //     int poff = (i * m_header.height + frame.y + r) * (m_header.width * m_header.frameNum) + j * m_header.width + frame.x;
-            //     int foff = r * frame.width;
-            //     for (int c = 0; c < frame.width; ++c) {
-            //         m_pixels[poff + c] = frame.pixels[foff + c];
-            //     }
-            // }
+    m_valid = true;
+}
+
+const Frame &Was::frameInfo(int direction, int index) const {
+    static const Frame EMPTY;
+    if (direction < 0 || direction >= directionCount() || index < 0 || index >= frameCount())
+        return EMPTY;
+    return m_frames[direction * m_header.frameNum + index].frame;
+}
+
+const Frame &Was::frame(int direction, int index) {
+    if (direction < 0 || direction >= directionCount() || index < 0 || index >= frameCount())
+        return frameInfo(direction, index);
+    Slot &slot = m_frames[direction * m_header.frameNum + index];
+    slot.lastUse = ++m_useClock;
+    if (!slot.buffer.empty() || slot.data.empty())
+        return slot.frame;
+
+    size_t count = (size_t) slot.frame.width * slot.frame.height;
+    size_t pixelSize = m_format == WPF_INDEXED ? sizeof(IndexedPixel) : sizeof(RGBA);
+    std::vector<uint8_t> reuse;
+    evict((count + 2) * pixelSize, reuse);
+    slot.buffer.swap(reuse);
+    slot.buffer.assign((count + 2) * pixelSize, 0);
+    if (m_format == WPF_INDEXED) {
+        auto *pixels = reinterpret_cast<IndexedPixel *>(slot.buffer.data()) + 1;
+        readFrame<IndexedPixel, false>(slot.data, INDEX_PALETTE.value, slot.frame, pixels, m_scratch);
+        slot.frame.indices = {pixels, count};
+    } else {
+        auto *pixels = reinterpret_cast<RGBA *>(slot.buffer.data()) + 1;
+        if (m_format == WPF_RGBA_PREMULTIPLIED)
+            readFrame<RGBA, true>(slot.data, m_palette.data(), slot.frame, pixels, m_scratch);
+        else
+            readFrame<RGBA, false>(slot.data, m_palette.data(), slot.frame, pixels, m_scratch);
+        slot.frame.pixels = {pixels, count};
+    }
+    m_cachedBytes += slot.buffer.size();
+    m_decoded++;
+    return slot.frame;
+}
+
+SpriteSheet Was::buildSheet(int maxWidth) {
+    SpriteSheet sheet;
+    if (m_format == WPF_INDEXED)
+        buildSheet(sheet, sheet.indices, &Frame::indices, maxWidth);
+    else
+        buildSheet(sheet, sheet.pixels, &Frame::pixels, maxWidth);
+    return sheet;
+}
+
+template <class Pixel>
+void Was::buildSheet(SpriteSheet &sheet, std::vector<Pixel> &pixels, std::span<const Pixel> Frame::*framePixels,
+                     int maxWidth) {
+    sheet.frames.resize(m_frames.size());
+
+    // 紧凑边界：alpha 不为 0 的像素
+    size_t area = 0;
+    int widest = 0, totalHeight = 0;
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        const Frame &f = frame((int) i / m_header.frameNum, (int) i % m_header.frameNum);
+        int left = (int) f.width, top = (int) f.height, right = -1, bottom = -1;
+        for (int y = 0; y < (int) f.height; y++) {
+            const Pixel *row = (f.*framePixels).data() + (size_t) y * f.width;
+            for (int x = 0; x < (int) f.width; x++) {
+                if (row[x].A) {
+                    left = std::min(left, x);
+                    right = std::max(right, x);
+                    top = std::min(top, y);
+                    bottom = y;
+                }
+            }
+        }
+        if (right < 0)
+            continue;
+        auto &rect = sheet.frames[i];
+        rect = {0, 0, left, top, right - left + 1, bottom - top + 1};
+        area += (size_t) (rect.width + 1) * (rect.height + 1);
+        widest = std::max(widest, rect.width + 1);
+        totalHeight += rect.height + 1;
+    }
+
+    // 从高到低摆放，同一货架上的帧高度接近
+    std::vector<size_t> order(m_frames.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sheet.frames[a].height > sheet.frames[b].height;
+    });
+    int width = std::max(widest, std::min(maxWidth, (int) std::ceil(std::sqrt((double) area))));
+    ShelfPacker packer(width, totalHeight);
+    for (size_t i: order) {
+        auto &rect = sheet.frames[i];
+        if (rect.width > 0)
+            packer.pack(rect.width, rect.height, rect.x, rect.y);
+    }
+
+    sheet.width = width;
+    sheet.height = packer.usedHeight();
+    pixels.assign((size_t) sheet.width * sheet.height, Pixel());
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        const auto &rect = sheet.frames[i];
+        if (rect.width == 0)
+            continue;
+        const Frame &f = frame((int) i / m_header.frameNum, (int) i % m_header.frameNum);
+        for (int y = 0; y < rect.height; y++) {
+            const Pixel *src = (f.*framePixels).data() + (size_t) (rect.offsetY + y) * f.width + rect.offsetX;
+            std::copy(src, src + rect.width, pixels.data() + (size_t) (rect.y + y) * sheet.width + rect.x);
         }
     }
-    file.close();
 }
 
-void Was::readFrame(std::vector<uint8_t> &buf, const std::vector<RGBA> &palette, Frame &frame) {
-    memcpy(&frame, buf.data(), offsetof(Frame, pixels));
-    uint32_t offset = offsetof(Frame, pixels);
+void Was::setCacheBytes(size_t bytes) {
+    m_cacheBytes = bytes;
+    std::vector<uint8_t> unused;
+    evict(0, unused);
+}
+
+void Was::evict(size_t needBytes, std::vector<uint8_t> &reuse) {
+    // 帧数不多，线性查找最久未用的已解码帧；换出帧的缓冲交给调用者复用
+    while (m_cachedBytes > 0 && m_cachedBytes + needBytes > m_cacheBytes) {
+        Slot *oldest = nullptr;
+        for (auto &slot: m_frames) {
+            if (!slot.buffer.empty() && (!oldest || slot.lastUse < oldest->lastUse))
+                oldest = &slot;
+        }
+        m_cachedBytes -= oldest->buffer.size();
+        oldest->frame.pixels = {};
+        oldest->frame.indices = {};
+        reuse = std::move(oldest->buffer);
+        oldest->buffer = {};
+    }
+}
 
-    std::vector<uint32_t> frameLineOffset(frame.height);
-    memcpy(frameLineOffset.data(), buf.data() + offset, sizeof(uint32_t) * frame.height);
-    // offset += sizeof(uint32_t) * frame.height;
+template <class Pixel, bool Premultiply>
+void Was::readFrame(std::span<const uint8_t> data, const Pixel *palette, const Frame &frame, Pixel *pixels,
+                    std::vector<uint8_t> &scratch) {
+    // 复制到补零的临时缓冲，越界的行读到 0 即结束；缓冲只增不减，在各帧间复用
+    if (scratch.size() < SCRATCH_FRONT + data.size() + SCRATCH_BACK)
+        scratch.resize(SCRATCH_FRONT + data.size() + SCRATCH_BACK);
+    uint8_t *buf = scratch.data() + SCRATCH_FRONT;
+    buf[-1] = 0;
+    memcpy(buf, data.data(), data.size());
+    memset(buf + data.size(), 0, SCRATCH_BACK);
+    const uint8_t *line = buf + FRAME_HEAD_SIZE;
 
-    frame.pixels.resize(frame.height * frame.width);
-    // std::vector<RGBA> rgba(frame.height * frame.width);
-    uint32_t pos = 0;
+    // 每行从行首写起，行内第 x 个像素写到 row[x]；x 可以等于 width（写到下一行行首），
+    // 也可能被 {11000000} 减到 -1，此时不再写入。一段数据写不完时该行结束
+    const int64_t width = frame.width;
     for (uint32_t h = 0; h < frame.height; h++) {
-        uint32_t linePixels = 0;
-        bool lineNotOver = true;
-        uint8_t *pData = buf.data() + frameLineOffset[h];
-
-        while (*pData != 0 && lineNotOver) {
-            uint8_t level = 0; // Alpha
-            uint8_t repeat = 0; // 重复次数
-            RGBA color; //重复颜色
-            uint8_t style = (*pData & 0xc0) >> 6; // 取字节的前两个比特
-            switch (style) {
-                case 0: // {00******}
-                    if (*pData & 0x20) {
-                        // {001*****} 表示带有Alpha通道的单个像素
-                        // {001 +5bit Alpha}+{1Byte Index}, 表示带有Alpha通道的单个像素。
-                        // {001 +0~31层Alpha通道}+{1~255个调色板引索}
-                        level = (*pData) & 0x1f; // 0x1f=(11111) 获得Alpha通道的值
-                        if (*(pData - 1) == 0xc0) {
-                            //特殊处理
-                            //Level = 31;
-                            //Pixels--;
-                            //pos--;
-                            if (linePixels <= frame.width) {
-                                frame.pixels[pos] = frame.pixels[pos - 1];
-                                linePixels++;
-                                pos++;
-                                pData += 2;
-                                break;
-                            } else {
-                                lineNotOver = false;
-                            }
-                        }
-                        pData++; // 下一个字节
-                        if (linePixels <= frame.width) {
-                            frame.pixels[pos] = palette[*pData];
-                            frame.pixels[pos].A = (level << 3) | 7 - 1;
-                            linePixels++;
-                            pos++;
-                            pData++;
+        uint32_t lineOffset;
+        memcpy(&lineOffset, line + h * sizeof(uint32_t), sizeof(uint32_t));
+        const uint8_t *pData = lineOffset < data.size() ? buf + lineOffset : buf + data.size();
+        Pixel *row = pixels + (size_t) h * frame.width;
+        int64_t x = 0;
+
+        for (uint8_t op = *pData; op != 0; op = *pData) {
+            // 本行还能写入的像素数
+            int64_t room = x >= 0 && x <= width ? width + 1 - x : 0;
+            int64_t repeat;
+            switch (op >> 6) {
+                case 0:
+                    if (op & 0x20) {
+                        // {001 +5bit Alpha}+{1Byte Index}，带 Alpha 的单个像素
+                        if (room == 0)
+                            goto lineEnd;
+                        if (pData[-1] == 0xc0) {
+                            // 紧跟在 {11000000} 之后时重复前一个像素
+                            row[x] = row[x - 1];
+                            pData += 2;
                         } else {
-                            lineNotOver = false;
+                            row[x] = withAlpha<Premultiply>(palette[pData[1]], (uint8_t) ((op & 0x1f) << 3 | 6));
+                            pData += 2;
                         }
+                        x++;
                     } else {
-                        // {000*****} 表示重复n次带有Alpha通道的像素
-                        // {000 +5bit Times}+{1Byte Alpha}+{1Byte Index}, 表示重复n次带有Alpha通道的像素。
-                        // {000 +重复1~31次}+{0~255层Alpha通道}+{1~255个调色板引索}
-                        // 注: 这里的{00000000} 保留给像素行结束使用，所以只可以重复1~31次。
-                        repeat = (*pData) & 0x1f; // 获得重复的次数
-                        pData++;
-                        level = *pData; // 获得Alpha通道值
-                        pData++;
-                        color = palette[*pData];
-                        color.A = (level << 3) | 7 - 1;
-                        for (int i = 1; i <= repeat; i++) {
-                            if (linePixels <= frame.width) {
-                                frame.pixels[pos] = color;
-                                pos++;
-                                linePixels++;
-                            } else {
-                                lineNotOver = false;
-                            }
-                        }
-                        pData++;
+                        // {000 +5bit Times}+{1Byte Alpha}+{1Byte Index}，重复 n 次带 Alpha 的像素
+                        repeat = op & 0x1f;
+                        fillPixels(row + x, std::min(repeat, room),
+                                   withAlpha<Premultiply>(palette[pData[2]], (uint8_t) (pData[1] << 3 | 6)));
+                        if (repeat > room)
+                            goto lineEnd;
+                        x += repeat;
+                        pData += 3;
                     }
                     break;
-                case 1: // {01******} 表示不带Alpha通道不重复的n个像素组成的数据段
-                    // {01  +6bit Times}+{nByte Datas},表示不带Alpha通道不重复的n个像素组成的数据段。
-                    // {01  +1~63个长度}+{n个字节的数据},{01000000}保留。
-                    repeat = (*pData) & 0x3f; // 获得数据组中的长度
-                    pData++;
-                    for (int i = 1; i <= repeat; i++) {
-                        if (linePixels <= frame.width) {
-                            frame.pixels[pos] = palette[*pData];
-                            pos++;
-                            linePixels++;
-                            pData++;
-                        } else {
-                            lineNotOver = false;
-                        }
-                    }
+                case 1:
+                    // {01 +6bit Times}+{nByte Datas}，不带 Alpha 的 n 个像素
+                    repeat = op & 0x3f;
+                    expandPixels(row + x, pData + 1, std::min(repeat, room), palette);
+                    if (repeat > room)
+                        goto lineEnd;
+                    x += repeat;
+                    pData += 1 + repeat;
                     break;
-                case 2: // {10******} 表示重复n次像素
-                    // {10  +6bit Times}+{1Byte Index}, 表示重复n次像素。
-                    // {10  +重复1~63次}+{0~255个调色板引索},{10000000}保留。
-                    repeat = (*pData) & 0x3f; // 获得重复的次数
-                    pData++;
-                    color = palette[*pData];
-                    for (int i = 1; i <= repeat; i++) {
-                        if (linePixels <= frame.width) {
-                            frame.pixels[pos] = color;
-                            pos++;
-                            linePixels++;
-                        } else {
-                            lineNotOver = false;
-                        }
-                    }
-                    pData++;
+                case 2:
+                    // {10 +6bit Times}+{1Byte Index}，重复 n 次像素
+                    repeat = op & 0x3f;
+                    fillPixels(row + x, std::min(repeat, room), palette[pData[1]]);
+                    if (repeat > room)
+                        goto lineEnd;
+                    x += repeat;
+                    pData += 2;
                     break;
-                case 3: // {11******} 表示跳过n个像素，跳过的像素用透明色代替
-                    // {11  +6bit Times}, 表示跳过n个像素，跳过的像素用透明色代替。
-                    // {11  +跳过1~63个像素},{11000000}保留。
-                    repeat = (*pData) & 0x3f; // 获得重复次数
+                default:
+                    // {11 +6bit Times}，跳过 n 个像素；{11000000} 退回一个像素
+                    repeat = op & 0x3f;
                     if (repeat == 0) {
-                        if (linePixels <= frame.width) {
-                            //特殊处理
-                            pos--;
-                            linePixels--;
-                        } else {
-                            lineNotOver = false;
-                        }
+                        if (room == 0)
+                            goto lineEnd;
+                        x--;
                     } else {
-                        for (int i = 1; i <= repeat; i++) {
-                            if (linePixels <= frame.width) {
-                                pos++;
-                                linePixels++;
-                            } else {
-                                lineNotOver = false;
-                            }
-                        }
+                        if (repeat > room)
+                            goto lineEnd;
+                        x += repeat;
                     }
                     pData++;
                     break;
-                default: // 一般不存在这种情况
-                    printf("WAS ERROR\n");
-                    break;
-            }
-        }
-        if (*pData == 0 || !lineNotOver) {
-            uint32_t repeat = frame.width - linePixels;
-            if (repeat > 0) {
-                pos += repeat;
             }
         }
+    lineEnd:;
     }
-    std::vector<uint32_t>().swap(frameLineOffset);
 }
 
 
 void Was::RGB565ToRGBA8888(uint16_t src, uint8_t alpha, RGBA &dst) {
-    uint8_t r = (src >> 11) & 0x1f;
-    uint8_t g = (src >> 5) & 0x3f;
-    uint8_t b = (src) & 0x1f;
-
-    dst.R = (r << 3) | (r >> 2);
-    dst.G = (g << 2) | (g >> 4);
-    dst.B = (b << 3) | (b >> 2);
+    dst.R = EXPAND_565.five[(src >> 11) & 0x1f];
+    dst.G = EXPAND_565.six[(src >> 5) & 0x3f];
+    dst.B = EXPAND_565.five[src & 0x1f];
     dst.A = alpha;
 }
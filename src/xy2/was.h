@@ -1,5 +1,7 @@
 #ifndef WAS_H
 #define WAS_H
+#include <array>
+#include <span>
 #include <vector>
 
 #include "wdf.h"
@@ -22,34 +24,126 @@ struct RGBA {
     uint8_t A{0};
 };
 
+// 调色板索引与 alpha，对应双通道（RG8）纹理
+struct IndexedPixel {
+    uint8_t I{0};
+    uint8_t A{0};
+};
+
+enum WasPixelFormat {
+    WPF_RGBA,
+    // RGB 预乘 alpha，可直接用 (ONE, ONE_MINUS_SRC_ALPHA) 混合
+    WPF_RGBA_PREMULTIPLIED,
+    // 不经调色板展开，输出 IndexedPixel，换色只需替换调色板
+    WPF_INDEXED,
+};
+
+// pixels / indices 按所属 Was 的格式只有一个非空，指向 Was 的帧缓存，帧被换出或 Was 析构后失效
 struct Frame {
     int32_t x{0};
     int32_t y{0};
-    uint32_t width;
-    uint32_t height;
+    uint32_t width{0};
+    uint32_t height{0};
+    std::span<const RGBA> pixels;
+    std::span<const IndexedPixel> indices;
+};
+
+// 帧在精灵图中的位置：帧内去掉透明边后的矩形 (offsetX, offsetY, width, height) 放在图中 (x, y) 处
+struct SheetFrame {
+    int x{0};
+    int y{0};
+    int offsetX{0};
+    int offsetY{0};
+    int width{0};
+    int height{0};
+};
+
+// 全部帧按紧凑边界装箱得到的精灵图，frames 按 方向 * 帧数 + 帧 排列；像素格式同 Was
+struct SpriteSheet {
+    int width{0};
+    int height{0};
     std::vector<RGBA> pixels;
+    std::vector<IndexedPixel> indices;
+    std::vector<SheetFrame> frames;
 };
 
 
+// 从内存中的条目数据解析，例如 Wdf::getData 返回的映射区域，data 需在 Was 的生命周期内有效。
+// 构造时只读取文件头、调色板与各帧的帧头，像素在 frame() 首次访问时才解码，
+// 解码结果按最近使用保留在缓存中，总量超过 cacheBytes 时换出最久未用的帧。非线程安全
 class Was {
 public:
-    Was(const std::string &path, const WasInfo &info);
+    static const size_t DEFAULT_CACHE_BYTES = 32 << 20;
+
+    explicit Was(std::span<const uint8_t> data, WasPixelFormat format = WPF_RGBA,
+                 size_t cacheBytes = DEFAULT_CACHE_BYTES);
+
+    Was(const Was &) = delete;
+    Was &operator=(const Was &) = delete;
+    Was(Was &&) = default;
+    Was &operator=(Was &&) = default;
 
-    const WasHeader &header() { return m_header; }
-    std::vector<std::vector<Frame> > fullFrames() const { return m_fullFrames; }
-    std::vector<uint8_t> times() const { return m_times; }
-    const std::vector<RGBA> &pixels() { return m_pixels; }
+    const WasHeader &header() const { return m_header; }
+    const std::vector<uint8_t> &times() const { return m_times; }
+    WasPixelFormat format() const { return m_format; }
+
+    // RGB565 展开后的调色板，alpha 为 255
+    const std::array<RGBA, 256> &palette() const { return m_palette; }
+
+    // 数据不完整或不是 PS 时为 false，此时没有帧
+    bool isValid() const { return m_valid; }
+
+    int directionCount() const { return m_valid ? m_header.directionNum : 0; }
+    int frameCount() const { return m_valid ? m_header.frameNum : 0; }
+
+    // 帧的位置与尺寸，不解码，像素仅在已缓存时非空
+    const Frame &frameInfo(int direction, int index) const;
+
+    // 解码并缓存一帧；返回的像素在之后的 frame() 调用换出该帧前有效。越界或损坏的帧没有像素
+    const Frame &frame(int direction, int index);
+
+    // 逐帧解码，裁掉透明边后用 ShelfPacker 装箱，图宽不超过 maxWidth（除非单帧更宽），高度按需
+    SpriteSheet buildSheet(int maxWidth = 2048);
+
+    // 缓存上限，调小时立即换出
+    void setCacheBytes(size_t bytes);
+
+    size_t cachedBytes() const { return m_cachedBytes; }
+    size_t decodedCount() const { return m_decoded; }
 
 private:
-    void readFrame(std::vector<uint8_t> &buf, const std::vector<RGBA> &palette, Frame &frame);
+    struct Slot {
+        Frame frame;
+        std::span<const uint8_t> data;
+        // 按格式存放像素，前后各多一个像素，容纳解码时行首行尾多读写的一个像素
+        std::vector<uint8_t> buffer;
+        uint64_t lastUse{0};
+    };
+
+    void evict(size_t needBytes, std::vector<uint8_t> &reuse);
+
+    template <class Pixel>
+    void buildSheet(SpriteSheet &sheet, std::vector<Pixel> &pixels, std::span<const Pixel> Frame::*framePixels,
+                    int maxWidth);
+
+    template <class Pixel, bool Premultiply>
+    static void readFrame(std::span<const uint8_t> data, const Pixel *palette, const Frame &frame, Pixel *pixels,
+                          std::vector<uint8_t> &scratch);
 
-    void RGB565ToRGBA8888(uint16_t src, uint8_t alpha, RGBA &dst);
+    static void RGB565ToRGBA8888(uint16_t src, uint8_t alpha, RGBA &dst);
 
 private:
-    WasHeader m_header;
+    WasHeader m_header{};
+    bool m_valid{false};
+    WasPixelFormat m_format;
     std::vector<uint8_t> m_times;
-    std::vector<std::vector<Frame> > m_fullFrames;
-    std::vector<RGBA> m_pixels;
+    std::array<RGBA, 256> m_palette;
+    std::vector<Slot> m_frames;
+    std::vector<uint8_t> m_scratch;
+    size_t m_cacheBytes;
+    size_t m_cachedBytes{0};
+    size_t m_decoded{0};
+    uint64_t m_useClock{0};
 };
 
 
@@ -1,7 +1,13 @@
 #include "wdf.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <vector>
+#include <sstream>
+
+#include "parallel.h"
+#include "wdfhash.h"
 
 // PFDW
 #define WDFP 0x57444650
@@ -24,6 +30,56 @@
 // RAR 0x726152
 #define RAR 0x6152
 
+static WasType sniffType(uint16_t flag) {
+    switch (flag) {
+        case PS:
+            return WT_PS;
+        case PK:
+            return WT_PK;
+        case MP3:
+            return WT_MP3;
+        case IR:
+            return WT_WAVE;
+        case FSB4:
+            return WT_FSB4;
+        case JPEG:
+            return WT_JPEG;
+        case TGA:
+            return WT_TGA;
+        case PNG:
+            return WT_PNG;
+        case RAR:
+            return WT_RAR;
+        default:
+            return WT_UNKNOWN;
+    }
+}
+
+const char *wasTypeName(WasType type) {
+    switch (type) {
+        case WT_PS:
+            return "PS";
+        case WT_PK:
+            return "PK";
+        case WT_MP3:
+            return "MP3";
+        case WT_WAVE:
+            return "WAVE";
+        case WT_FSB4:
+            return "FSB4";
+        case WT_JPEG:
+            return "JPEG";
+        case WT_TGA:
+            return "TGA";
+        case WT_PNG:
+            return "PNG";
+        case WT_RAR:
+            return "RAR";
+        default:
+            return "???";
+    }
+}
+
 Wdf::Wdf() {
 }
 
@@ -38,65 +94,171 @@ bool Wdf::load(const std::string &path) {
     m_path = path;
     m_isValid = false;
     m_wasInfos.clear();
+    m_types.clear();
+    m_sniffed = 0;
+    m_names.clear();
 
-    std::fstream file(path, std::ios::binary | std::ios::in);
-    if (!file.is_open()) {
+    if (!m_file.open(path)) {
         std::cerr << "Failed to open file " << path << std::endl;
         return m_isValid;
     }
 
-    std::cout << "WDF init: " << path << std::endl;
-
-    file.read((char *) (&m_header), sizeof(m_header));
+    const uint8_t *data = m_file.data();
+    size_t size = m_file.size();
+    if (size < sizeof(m_header)) {
+        std::cerr << "File is not a WDF file" << std::endl;
+        m_file.close();
+        return m_isValid;
+    }
+    memcpy(&m_header, data, sizeof(m_header));
 
     if (m_header.flag != WDFP) {
         std::cerr << "File is not a WDF file" << std::endl;
-        file.close();
+        m_file.close();
         return m_isValid;
     }
-    file.seekg(m_header.offset, std::ios::beg);
-    WasInfo was;
-    for (int i = 0; i < m_header.wasCount; i++) {
-        file.read((char *) (&was), offsetof(WasInfo, type));
-        m_wasInfos[was.hash] = was;
-    }
-    for (auto &d: m_wasInfos) {
-        file.seekg(d.second.offset, std::ios::beg);
-        file.read((char *) (&d.second.flag), sizeof(d.second.flag));
-        switch (d.second.flag) {
-            case PS:
-                d.second.type = WT_PS;
-                break;
-            case PK:
-                d.second.type = WT_PK;
-                break;
-            case MP3:
-                d.second.type = WT_MP3;
-            break;
-            case IR:
-                d.second.type = WT_WAVE;
-                break;
-            case FSB4:
-                d.second.type = WT_FSB4;
-                break;
-            case JPEG:
-                d.second.type = WT_JPEG;
-                break;
-            case TGA:
-                d.second.type = WT_TGA;
-                break;
-            case PNG:
-                d.second.type = WT_PNG;
-            break;
-            case RAR:
-                d.second.type = WT_RAR;
-            break;
-            default:
-                d.second.type = WT_UNKNOWN;
-        }
+
+    // 索引项为 hash, offset, size, spaces 四个 uint32，与 WasInfo 布局一致
+    static_assert(sizeof(WasInfo) == 16);
+    if (m_header.offset > size || (size - m_header.offset) / sizeof(WasInfo) < m_header.wasCount) {
+        std::cerr << "WDF index out of range" << std::endl;
+        m_file.close();
+        return m_isValid;
     }
-    file.close();
+    m_wasInfos.resize(m_header.wasCount);
+    if (!m_wasInfos.empty())
+        memcpy(m_wasInfos.data(), data + m_header.offset, m_wasInfos.size() * sizeof(WasInfo));
+
+    // hash 重复时保留索引中靠后的一项
+    std::ranges::stable_sort(m_wasInfos, {}, &WasInfo::hash);
+    auto last = std::unique(m_wasInfos.rbegin(), m_wasInfos.rend(), [](const WasInfo &a, const WasInfo &b) {
+        return a.hash == b.hash;
+    });
+    m_wasInfos.erase(m_wasInfos.begin(), last.base());
+    m_types = std::vector<std::atomic<uint8_t> >(m_wasInfos.size());
+
     m_isValid = true;
-    std::cout << "WDF init success!" << std::endl;
     return m_isValid;
 }
+
+const WasInfo *Wdf::find(uint32_t hash) const {
+    auto it = std::ranges::lower_bound(m_wasInfos, hash, {}, &WasInfo::hash);
+    return it != m_wasInfos.end() && it->hash == hash ? &*it : nullptr;
+}
+
+const WasInfo *Wdf::find(std::string_view path) const {
+    return find(wdfHash(path));
+}
+
+std::span<const uint8_t> Wdf::getData(const WasInfo &info) const {
+    if (info.offset > m_file.size() || m_file.size() - info.offset < info.size)
+        return {};
+    return {m_file.data() + info.offset, info.size};
+}
+
+WasType Wdf::getType(const WasInfo &info) const {
+    size_t index = &info - m_wasInfos.data();
+    if (index >= m_wasInfos.size())
+        return WT_UNKNOWN;
+    uint8_t cached = m_types[index].load(std::memory_order_relaxed);
+    if (cached)
+        return (WasType) (cached - 1);
+
+    WasType type = WT_UNKNOWN;
+    uint16_t flag;
+    if (info.offset <= m_file.size() && m_file.size() - info.offset >= sizeof(flag)) {
+        memcpy(&flag, m_file.data() + info.offset, sizeof(flag));
+        type = sniffType(flag);
+    }
+    // 多个线程同时识别同一条目时只计一次
+    if (m_types[index].compare_exchange_strong(cached, (uint8_t) (type + 1), std::memory_order_relaxed))
+        m_sniffed.fetch_add(1, std::memory_order_relaxed);
+    return type;
+}
+
+void Wdf::sniffAll(int threads) const {
+    std::vector<uint32_t> order;
+    for (size_t i = 0; i < m_wasInfos.size(); i++) {
+        if (!m_types[i].load(std::memory_order_relaxed))
+            order.push_back((uint32_t) i);
+    }
+    // 按偏移排序后每个线程顺序读取一段连续的条目，映射的页面按文件顺序换入
+    std::ranges::sort(order, {}, [&](uint32_t i) { return m_wasInfos[i].offset; });
+    const size_t CHUNK = 4096;
+    ParallelFor((order.size() + CHUNK - 1) / CHUNK, threads, [&](size_t chunk) {
+        size_t end = std::min(order.size(), (chunk + 1) * CHUNK);
+        for (size_t i = chunk * CHUNK; i < end; i++)
+            getType(m_wasInfos[order[i]]);
+    });
+}
+
+size_t Wdf::addNames(std::span<const std::string_view> paths, int threads) {
+    std::vector<uint32_t> hashes(paths.size());
+    wdfHashBatch(paths, hashes, threads);
+    return addNames(paths, hashes);
+}
+
+size_t Wdf::addNames(std::span<const std::string_view> paths, std::span<const uint32_t> hashes) {
+    // 名称表在第一次加名称时才分配
+    if (m_names.empty())
+        m_names.resize(m_wasInfos.size());
+    size_t added = 0;
+    for (size_t i = 0; i < paths.size() && i < hashes.size(); i++) {
+        const WasInfo *info = find(hashes[i]);
+        if (!info)
+            continue;
+        std::string &name = m_names[info - m_wasInfos.data()];
+        if (name.empty())
+            added++;
+        name = paths[i];
+    }
+    return added;
+}
+
+bool Wdf::readNameList(const std::string &path, std::string &text, std::vector<std::string_view> &names) {
+    names.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file " << path << std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    text = ss.str();
+
+    // 按行切分，忽略行尾的 '\r' 与空行
+    std::string_view rest(text);
+    while (!rest.empty()) {
+        size_t end = rest.find('\n');
+        std::string_view line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if (!line.empty())
+            names.push_back(line);
+    }
+    return true;
+}
+
+size_t Wdf::loadNames(const std::string &path, int threads) {
+    std::string text;
+    std::vector<std::string_view> paths;
+    if (!readNameList(path, text, paths))
+        return 0;
+    size_t added = addNames(paths, threads);
+    std::clog << "WDF names: " << added << "/" << paths.size() << " matched" << std::endl;
+    return added;
+}
+
+size_t Wdf::memoryBytes() const {
+    size_t bytes = m_wasInfos.capacity() * sizeof(WasInfo) + m_types.capacity() * sizeof(std::atomic<uint8_t>)
+                   + m_names.capacity() * sizeof(std::string);
+    for (const auto &name: m_names)
+        bytes += name.empty() ? 0 : name.capacity() + 1;
+    return bytes;
+}
+
+std::string_view Wdf::getName(const WasInfo &info) const {
+    size_t index = &info - m_wasInfos.data();
+    return index < m_names.size() ? std::string_view(m_names[index]) : std::string_view();
+}
@@ -1,7 +1,13 @@
 #ifndef WDF_H
 #define WDF_H
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedfile.h"
 
 enum WasType {
     WT_UNKNOWN,
@@ -27,28 +33,68 @@ struct WasInfo {
     uint32_t offset;
     uint32_t size;
     uint32_t spaces;
-
-    WasType type;
-    uint16_t flag;
 };
 
+const char *wasTypeName(WasType type);
 
-
+// 内存映射整个 wdf 文件，索引为按 hash 排序的数组，条目数据直接指向映射。
+// 打开时只读索引，条目类型在首次访问时才读取开头 2 字节识别
 class Wdf {
 public:
     Wdf();
     Wdf(const std::string &path);
     ~Wdf();
     bool load(const std::string &path);
-    std::string getPath() const {return m_path;}
-    WdfHeader getHeader() const {return m_header;}
-    std::map<uint32_t, WasInfo> getWasInfos() const {return m_wasInfos;}
+    const std::string &getPath() const {return m_path;}
+    const WdfHeader &getHeader() const {return m_header;}
+    size_t getFileSize() const {return m_file.size();}
+    std::span<const WasInfo> getWasInfos() const {return m_wasInfos;}
     bool isValid() const {return m_isValid;}
 
+    // 二分查找，不存在时返回 nullptr
+    const WasInfo *find(uint32_t hash) const;
+
+    // 按路径查找，路径经 wdfHash 转为 hash
+    const WasInfo *find(std::string_view path) const;
+
+    // 条目在映射中的数据，越界时为空；load 或析构后失效
+    std::span<const uint8_t> getData(const WasInfo &info) const;
+
+    // 条目类型，首次访问时识别并缓存，可多线程调用；info 须来自 getWasInfos() 或 find()
+    WasType getType(const WasInfo &info) const;
+
+    // 按偏移顺序批量识别尚未识别的条目，threads 为 0 时使用硬件线程数
+    void sniffAll(int threads = 0) const;
+
+    // 实际读取过类型的条目数
+    size_t sniffedCount() const {return m_sniffed.load(std::memory_order_relaxed);}
+
+    // 批量计算路径 hash，为存在于本文件的条目记下路径，返回新命名的条目数
+    size_t addNames(std::span<const std::string_view> paths, int threads = 0);
+
+    // hashes[i] 为 paths[i] 的 wdfHash，多个文件共用同一份名称列表时只需计算一次
+    size_t addNames(std::span<const std::string_view> paths, std::span<const uint32_t> hashes);
+
+    // 读取每行一个路径的名称列表文件并 addNames
+    size_t loadNames(const std::string &path, int threads = 0);
+
+    // 读取名称列表文件，names 指向 text 中的各行（已去掉 '\r' 与空行）
+    static bool readNameList(const std::string &path, std::string &text, std::vector<std::string_view> &names);
+
+    // 索引、类型缓存与名称占用的内存，不含映射
+    size_t memoryBytes() const;
+
+    // 条目的路径，未知时为空
+    std::string_view getName(const WasInfo &info) const;
+
 private:
     std::string m_path;
-    WdfHeader m_header;
-    std::map<uint32_t, WasInfo> m_wasInfos;
+    WdfHeader m_header {};
+    MappedFile m_file;
+    std::vector<WasInfo> m_wasInfos;
+    mutable std::vector<std::atomic<uint8_t> > m_types;  // WasType + 1，0 为尚未识别
+    mutable std::atomic<size_t> m_sniffed {0};
+    std::vector<std::string> m_names;  // 与 m_wasInfos 对应，未加载名称时为空
     bool m_isValid {false};
 };
 
@@ -0,0 +1,101 @@
+#include "wdfhash.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WDFHASH_USE_SSE2 1
+#else
+#define WDFHASH_USE_SSE2 0
+#endif
+
+namespace {
+    // 一个 hash 最多 64 组路径字加 2 个固定字
+    const int MAX_ROUNDS = 66;
+
+    struct Keys {
+        uint32_t value[MAX_ROUNDS];
+
+        constexpr Keys() : value() {
+            for (int k = 0; k < MAX_ROUNDS; k++)
+                value[k] = wdfHashKey(k);
+        }
+    };
+
+    constexpr Keys KEYS;
+
+#if WDFHASH_USE_SSE2
+    // 将路径做 string_adjust 后按字写入 words（含末尾两个固定字），返回轮数
+    int adjustWords(std::string_view path, uint32_t *words) {
+        size_t length = std::min<size_t>(path.size(), 256);
+        if (const void *end = memchr(path.data(), 0, length))
+            length = (const char *) end - path.data();
+
+        // 每次 16 字节：'A'-'Z' 加 0x20，'/' 换成 '\'；最后不足 16 字节的部分先复制到补零的临时块
+        const __m128i upperLow = _mm_set1_epi8('A' - 1), upperHigh = _mm_set1_epi8('Z' + 1);
+        const __m128i caseBit = _mm_set1_epi8(0x20), slash = _mm_set1_epi8('/'), backslash = _mm_set1_epi8('\\');
+        for (size_t i = 0; i < length; i += 16) {
+            __m128i v;
+            if (i + 16 <= length) {
+                v = _mm_loadu_si128((const __m128i *) (path.data() + i));
+            } else {
+                alignas(16) uint8_t tail[16] = {};
+                memcpy(tail, path.data() + i, length - i);
+                v = _mm_load_si128((const __m128i *) tail);
+            }
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, upperLow), _mm_cmplt_epi8(v, upperHigh));
+            v = _mm_add_epi8(v, _mm_and_si128(upper, caseBit));
+            __m128i isSlash = _mm_cmpeq_epi8(v, slash);
+            v = _mm_or_si128(_mm_andnot_si128(isSlash, v), _mm_and_si128(isSlash, backslash));
+            _mm_storeu_si128((__m128i *) (words + i / 4), v);
+        }
+
+        int count = (int) ((length + 3) / 4);
+        words[count] = 0x9BE74448u;
+        words[count + 1] = 0x66F42C48u;
+        return count + 2;
+    }
+
+    // 多条路径交错计算：每条路径的各轮互相依赖，交错后乘法延迟可以重叠
+    template <int N>
+    void hashGroup(const std::string_view *paths, uint32_t *out) {
+        uint32_t words[N][MAX_ROUNDS];
+        int rounds[N], maxRounds = 0;
+        uint32_t x[N], y[N];
+        for (int n = 0; n < N; n++) {
+            rounds[n] = adjustWords(paths[n], words[n]);
+            maxRounds = std::max(maxRounds, rounds[n]);
+            x[n] = 0x37A8470Eu;
+            y[n] = 0x7758B42Bu;
+        }
+        for (int k = 0; k < maxRounds; k++) {
+            for (int n = 0; n < N; n++) {
+                uint32_t nx = x[n], ny = y[n];
+                wdfHashRound(nx, ny, KEYS.value[k], words[n][std::min(k, rounds[n] - 1)]);
+                if (k < rounds[n]) {
+                    x[n] = nx;
+                    y[n] = ny;
+                }
+            }
+        }
+        for (int n = 0; n < N; n++)
+            out[n] = x[n] ^ y[n];
+    }
+#endif
+}
+
+void wdfHashBatch(std::span<const std::string_view> paths, std::span<uint32_t> out, int threads) {
+    size_t count = std::min(paths.size(), out.size());
+    const size_t CHUNK = 4096;
+    ParallelFor((count + CHUNK - 1) / CHUNK, threads, [&](size_t chunk) {
+        size_t begin = chunk * CHUNK, end = std::min(count, begin + CHUNK);
+        size_t i = begin;
+#if WDFHASH_USE_SSE2
+        for (; i + 4 <= end; i += 4)
+            hashGroup<4>(&paths[i], &out[i]);
+#endif
+        for (; i < end; i++)
+            out[i] = wdfHash(paths[i]);
+    });
+}
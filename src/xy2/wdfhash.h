@@ -0,0 +1,77 @@
+#ifndef WDFHASH_H
+#define WDFHASH_H
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// 游戏 wdf 的路径 hash（string_id）：路径先转小写、'/' 转 '\'（string_adjust），
+// 最多取前 256 字节按 4 字节小端分组，末尾补两个固定字，逐组做乘法混合。
+// wdfHash 为 constexpr，已知路径可在编译期求值：constexpr uint32_t h = wdfHash("shape/char/0001/stand.tcp");
+
+constexpr char wdfHashAdjust(char c) {
+    return c >= 'A' && c <= 'Z' ? (char) (c + 'a' - 'A') : c == '/' ? '\\' : c;
+}
+
+// 参与 hash 的字节数：截断到 256 字节，遇 '\0' 结束
+constexpr size_t wdfHashLength(std::string_view path) {
+    size_t length = path.size() < 256 ? path.size() : 256;
+    for (size_t i = 0; i < length; i++) {
+        if (path[i] == '\0')
+            return i;
+    }
+    return length;
+}
+
+// 第 k 轮的常量，与路径无关：0x267B0B11 ^ rol(0xF4FA8928, k + 1)
+constexpr uint32_t wdfHashKey(int k) {
+    int r = (k + 1) & 31;
+    uint32_t v = r ? (0xF4FA8928u << r) | (0xF4FA8928u >> (32 - r)) : 0xF4FA8928u;
+    return 0x267B0B11u ^ v;
+}
+
+// 一轮混合，x、y 为上一轮结果，等价于原实现中的 esi、edi 及其进位处理
+constexpr void wdfHashRound(uint32_t &x, uint32_t &y, uint32_t key, uint32_t word) {
+    x ^= word;
+    y ^= word;
+
+    uint32_t a = ((key + y) | 0x02040801u) & 0xBFEF7FDFu;
+    uint64_t p = (uint64_t) x * a;
+    uint32_t lo = (uint32_t) p, hi = (uint32_t) (p >> 32);
+    uint64_t s = (uint64_t) lo + hi + (hi != 0);
+    uint32_t nx = (uint32_t) s + (uint32_t) (s >> 32);
+
+    uint32_t b = ((key + x) | 0x00804021u) & 0x7DFEFBFFu;
+    p = (uint64_t) y * b;
+    lo = (uint32_t) p;
+    hi = (uint32_t) (p >> 32);
+    s = (uint64_t) lo + (uint32_t) (hi << 1) + (hi >> 31);
+    uint32_t ny = (uint32_t) s + ((s >> 32) ? 2 : 0);
+
+    x = nx;
+    y = ny;
+}
+
+constexpr uint32_t wdfHash(std::string_view path) {
+    const uint32_t TAIL[2] = {0x9BE74448u, 0x66F42C48u};
+    size_t length = wdfHashLength(path);
+    int words = (int) ((length + 3) / 4);
+    uint32_t x = 0x37A8470Eu, y = 0x7758B42Bu;
+    for (int k = 0; k < words + 2; k++) {
+        uint32_t word = 0;
+        if (k < words) {
+            for (int i = 0; i < 4 && k * 4 + i < (int) length; i++)
+                word |= (uint32_t) (uint8_t) wdfHashAdjust(path[k * 4 + i]) << (i * 8);
+        } else {
+            word = TAIL[k - words];
+        }
+        wdfHashRound(x, y, wdfHashKey(k), word);
+    }
+    return x ^ y;
+}
+
+// 批量计算 out[i] = wdfHash(paths[i])，threads 为 0 时使用硬件线程数。
+// SSE2 下 string_adjust 每次处理 16 字节，并将四条路径的各轮交错计算
+void wdfHashBatch(std::span<const std::string_view> paths, std::span<uint32_t> out, int threads = 0);
+
+
+#endif //WDFHASH_H
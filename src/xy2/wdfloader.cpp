@@ -0,0 +1,111 @@
+#include "wdfloader.h"
+#include <algorithm>
+
+#include "mappedfile.h"
+
+namespace {
+    // 逐页读取一个字节，把页面换入内存
+    const size_t PAGE_SIZE = 4096;
+
+    // 等待的读取达到此数量时优先处理读取，否则优先继续执行就绪的协程以攒成更大的批
+    const size_t BATCH_SIZE = 64;
+}
+
+void WdfLoader::FinalAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    auto task = std::coroutine_handle<Task::promise_type>::from_address(handle.address());
+    task.promise().loader->finish(handle);
+}
+
+WdfLoader::WdfLoader(int threads) {
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 0; t < threads; t++)
+        m_workers.emplace_back([this]() { workerLoop(); });
+}
+
+WdfLoader::~WdfLoader() {
+    wait();
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker: m_workers)
+        worker.join();
+}
+
+void WdfLoader::spawn(Task task) {
+    auto handle = std::exchange(task.m_handle, nullptr);
+    handle.promise().loader = this;
+    {
+        std::lock_guard lock(m_mutex);
+        m_running++;
+        m_ready.push_back(handle);
+    }
+    m_wake.notify_one();
+}
+
+void WdfLoader::wait() {
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [&]() { return m_running == 0; });
+}
+
+void WdfLoader::enqueueRead(std::span<const uint8_t> data, std::coroutine_handle<> handle) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_reads.push_back({data, handle});
+    }
+    m_readCount.fetch_add(1, std::memory_order_relaxed);
+    m_wake.notify_one();
+}
+
+void WdfLoader::finish(std::coroutine_handle<> handle) {
+    handle.destroy();
+    std::lock_guard lock(m_mutex);
+    if (--m_running == 0)
+        m_idle.notify_all();
+}
+
+void WdfLoader::workerLoop() {
+    std::vector<Read> batch;
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [&]() { return m_stop || !m_ready.empty() || !m_reads.empty(); });
+        if (!m_reads.empty() && (m_reads.size() >= BATCH_SIZE || m_ready.empty())) {
+            batch.swap(m_reads);
+            lock.unlock();
+            loadBatch(batch);
+            lock.lock();
+            for (const auto &read: batch)
+                m_ready.push_back(read.handle);
+            batch.clear();
+            m_wake.notify_all();
+        } else if (!m_ready.empty()) {
+            auto handle = m_ready.front();
+            m_ready.pop_front();
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        } else if (m_stop) {
+            return;
+        }
+    }
+}
+
+void WdfLoader::loadBatch(std::vector<Read> &batch) {
+    m_batchCount.fetch_add(1, std::memory_order_relaxed);
+
+    // 同一文件的条目按偏移排列，先一并提示预读，再按顺序逐页换入
+    std::ranges::sort(batch, {}, [](const Read &read) { return read.data.data(); });
+    for (const auto &read: batch)
+        MappedFile::prefetch(read.data);
+    uint8_t sum = 0;
+    for (const auto &read: batch) {
+        for (size_t i = 0; i < read.data.size(); i += PAGE_SIZE)
+            sum += read.data[i];
+        sum += read.data.back();
+    }
+    // 防止读取被优化掉
+    volatile uint8_t sink = sum;
+    (void) sink;
+}
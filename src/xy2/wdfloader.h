@@ -0,0 +1,108 @@
+#ifndef WDFLOADER_H
+#define WDFLOADER_H
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "wdfvfs.h"
+
+// 协程式的条目读取：在 WdfLoader::Task 协程中 co_await loader.read(...) 得到条目数据。
+// 等待中的读取由空闲线程成批取走，按地址（即文件内偏移）排序后预读并逐页换入，再把协程交回线程池继续执行，
+// 一个协程解码时其他线程在换入下一批数据，I/O 与解码重叠。
+class WdfLoader {
+public:
+    class Task;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {return false;}
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    // 协程返回类型：交给 spawn 后在线程池中执行，结束时自动销毁
+    class Task {
+    public:
+        struct promise_type {
+            WdfLoader *loader {nullptr};
+
+            Task get_return_object() {return Task(std::coroutine_handle<promise_type>::from_promise(*this));}
+            std::suspend_always initial_suspend() const noexcept {return {};}
+            FinalAwaiter final_suspend() const noexcept {return {};}
+            void return_void() const {}
+            void unhandled_exception() const {std::terminate();}
+        };
+
+        Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        ~Task() {if (m_handle) m_handle.destroy();}
+
+    private:
+        friend class WdfLoader;
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    struct ReadAwaiter {
+        WdfLoader *loader;
+        std::span<const uint8_t> data;
+
+        bool await_ready() const noexcept {return data.empty();}
+        void await_suspend(std::coroutine_handle<> handle) {loader->enqueueRead(data, handle);}
+        std::span<const uint8_t> await_resume() const noexcept {return data;}
+    };
+
+    // threads 为 0 时使用硬件线程数
+    explicit WdfLoader(int threads = 0);
+    ~WdfLoader();
+
+    WdfLoader(const WdfLoader &) = delete;
+    WdfLoader &operator=(const WdfLoader &) = delete;
+
+    // 条目数据在 co_await 返回时已换入内存；越界的条目立即返回空
+    ReadAwaiter read(const Wdf &wdf, const WasInfo &info) {return {this, wdf.getData(info)};}
+    ReadAwaiter read(const WdfVfs &vfs, const WdfVfs::Entry &entry) {return {this, vfs.getData(entry)};}
+
+    // 开始执行协程，可在任意线程（包括协程内）调用
+    void spawn(Task task);
+
+    // 等待已 spawn 的协程全部结束
+    void wait();
+
+    size_t readCount() const {return m_readCount.load(std::memory_order_relaxed);}
+    size_t batchCount() const {return m_batchCount.load(std::memory_order_relaxed);}
+
+private:
+    struct Read {
+        std::span<const uint8_t> data;
+        std::coroutine_handle<> handle;
+    };
+
+    void enqueueRead(std::span<const uint8_t> data, std::coroutine_handle<> handle);
+    void finish(std::coroutine_handle<> handle);
+    void workerLoop();
+    void loadBatch(std::vector<Read> &batch);
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<std::coroutine_handle<> > m_ready;
+    std::vector<Read> m_reads;
+    size_t m_running {0};
+    bool m_stop {false};
+    std::vector<std::thread> m_workers;
+
+    std::atomic<size_t> m_readCount {0};
+    std::atomic<size_t> m_batchCount {0};
+};
+
+
+#endif //WDFLOADER_H
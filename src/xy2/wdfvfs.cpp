@@ -0,0 +1,166 @@
+#include "wdfvfs.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "wdfhash.h"
+
+size_t WdfVfs::mount(std::span<const std::string> paths, int threads) {
+    auto start = std::chrono::steady_clock::now();
+    clear();
+
+    // 文件大小差异较大，按原子计数逐个领取
+    std::vector<std::unique_ptr<Wdf> > loaded(paths.size());
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (int) std::min<size_t>(threads, std::max<size_t>(paths.size(), 1));
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < paths.size(); i = next++) {
+                loaded[i] = std::make_unique<Wdf>();
+                if (!loaded[i]->load(paths[i]))
+                    loaded[i].reset();
+            }
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    for (auto &wdf: loaded) {
+        if (wdf)
+            m_archives.push_back(std::move(wdf));
+    }
+
+    // 同一 hash 按优先级从高到低排列，只保留第一项
+    size_t total = 0;
+    for (const auto &wdf: m_archives)
+        total += wdf->getWasInfos().size();
+    m_entries.reserve(total);
+    for (uint32_t a = 0; a < m_archives.size(); a++) {
+        for (const auto &info: m_archives[a]->getWasInfos())
+            m_entries.push_back({info.hash, a, &info});
+    }
+    std::ranges::sort(m_entries, [](const Entry &l, const Entry &r) {
+        return l.hash != r.hash ? l.hash < r.hash : l.archive > r.archive;
+    });
+    auto last = std::ranges::unique(m_entries, {}, &Entry::hash).begin();
+    m_entries.erase(last, m_entries.end());
+    m_entries.shrink_to_fit();
+
+    // 装载率不超过 1/2 的线性探测表，hash 本身已足够均匀，乘法散列后取高位
+    int bits = 4;
+    while ((size_t(1) << bits) < m_entries.size() * 2)
+        bits++;
+    m_slotShift = 32 - bits;
+    m_slots.assign(size_t(1) << bits, EMPTY_SLOT);
+    size_t mask = m_slots.size() - 1;
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        size_t slot = (m_entries[i].hash * 0x9E3779B1u) >> m_slotShift;
+        while (m_slots[slot] != EMPTY_SLOT)
+            slot = (slot + 1) & mask;
+        m_slots[slot] = i;
+    }
+
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_stats.archives = m_archives.size();
+    m_stats.entries = total;
+    m_stats.overridden = total - m_entries.size();
+    // load 在工作线程中执行，不逐个输出，汇总为一行
+    std::clog << "WDF mounted " << m_archives.size() << "/" << paths.size() << " archives, " << m_entries.size()
+              << " entries in " << m_stats.seconds << " s" << std::endl;
+    return m_archives.size();
+}
+
+size_t WdfVfs::mountDirectory(const std::string &dir, int threads) {
+    struct Archive {
+        std::string stem;
+        int rank;  // .wdf 为 0，.wdN 为 N
+        std::string path;
+    };
+    std::vector<Archive> archives;
+    std::error_code ec;
+    for (const auto &entry: std::filesystem::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file())
+            continue;
+        std::string ext = entry.path().extension().string(), stem = entry.path().stem().string();
+        std::ranges::transform(ext, ext.begin(), [](char c) { return (char) tolower((unsigned char) c); });
+        std::ranges::transform(stem, stem.begin(), [](char c) { return (char) tolower((unsigned char) c); });
+        if (ext.size() != 4 || !ext.starts_with(".wd"))
+            continue;
+        if (ext[3] == 'f')
+            archives.push_back({stem, 0, entry.path().string()});
+        else if (ext[3] >= '1' && ext[3] <= '9')
+            archives.push_back({stem, ext[3] - '0', entry.path().string()});
+    }
+    std::ranges::sort(archives, [](const Archive &l, const Archive &r) {
+        return l.stem != r.stem ? l.stem < r.stem : l.rank < r.rank;
+    });
+
+    std::vector<std::string> paths;
+    for (auto &archive: archives)
+        paths.push_back(std::move(archive.path));
+    return mount(paths, threads);
+}
+
+void WdfVfs::clear() {
+    m_entries.clear();
+    m_slots.clear();
+    m_archives.clear();
+    m_stats = {};
+}
+
+const WdfVfs::Entry *WdfVfs::find(uint32_t hash) const {
+    if (m_slots.empty())
+        return nullptr;
+    size_t mask = m_slots.size() - 1;
+    for (size_t slot = (hash * 0x9E3779B1u) >> m_slotShift;; slot = (slot + 1) & mask) {
+        uint32_t index = m_slots[slot];
+        if (index == EMPTY_SLOT)
+            return nullptr;
+        if (m_entries[index].hash == hash)
+            return &m_entries[index];
+    }
+}
+
+const WdfVfs::Entry *WdfVfs::find(std::string_view path) const {
+    return find(wdfHash(path));
+}
+
+void WdfVfs::sniffAll(int threads) const {
+    for (const auto &wdf: m_archives)
+        wdf->sniffAll(threads);
+}
+
+size_t WdfVfs::sniffedCount() const {
+    size_t count = 0;
+    for (const auto &wdf: m_archives)
+        count += wdf->sniffedCount();
+    return count;
+}
+
+size_t WdfVfs::loadNames(const std::string &path, int threads) {
+    std::string text;
+    std::vector<std::string_view> paths;
+    if (!Wdf::readNameList(path, text, paths))
+        return 0;
+    std::vector<uint32_t> hashes(paths.size());
+    wdfHashBatch(paths, hashes, threads);
+    size_t added = 0;
+    for (auto &wdf: m_archives)
+        added += wdf->addNames(paths, hashes);
+    std::clog << "WDF names: " << added << " entries named from " << paths.size() << " paths" << std::endl;
+    return added;
+}
+
+size_t WdfVfs::memoryBytes() const {
+    size_t bytes = m_entries.capacity() * sizeof(Entry) + m_slots.capacity() * sizeof(uint32_t)
+                   + m_archives.capacity() * sizeof(std::unique_ptr<Wdf>);
+    for (const auto &wdf: m_archives)
+        bytes += sizeof(Wdf) + wdf->memoryBytes();
+    return bytes;
+}
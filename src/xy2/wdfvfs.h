@@ -0,0 +1,79 @@
+#ifndef WDFVFS_H
+#define WDFVFS_H
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "wdf.h"
+
+// 同时挂载多个 wdf：按优先级合并为一个只读索引，同一 hash 以优先级最高的文件为准（补丁覆盖本体）。
+// 挂载完成后索引不再变化，查找不加锁，可多线程并发调用；挂载期间不可查询
+class WdfVfs {
+public:
+    struct Entry {
+        uint32_t hash;
+        uint32_t archive;     // 所在文件，即 archive() 的下标
+        const WasInfo *info;  // 指向所在文件的索引
+    };
+
+    struct MountStats {
+        double seconds;     // 打开全部文件并合并索引的耗时
+        size_t archives;    // 成功打开的文件数
+        size_t entries;     // 各文件条目数之和
+        size_t overridden;  // 被更高优先级文件覆盖的条目数
+    };
+
+    // paths 按优先级从低到高排列，threads 为 0 时使用硬件线程数；返回成功打开的文件数
+    size_t mount(std::span<const std::string> paths, int threads = 0);
+
+    // 挂载目录下全部 .wdf 及补丁 .wd1 - .wd9：同名按 .wdf、.wd1、.wd2 ... 依次提高优先级，不同名按文件名排序
+    size_t mountDirectory(const std::string &dir, int threads = 0);
+
+    void clear();
+
+    const Entry *find(uint32_t hash) const;
+
+    const Entry *find(std::string_view path) const;
+
+    // 合并后的全部条目，按 hash 排序
+    std::span<const Entry> entries() const {return m_entries;}
+
+    size_t archiveCount() const {return m_archives.size();}
+
+    const Wdf &archive(size_t index) const {return *m_archives[index];}
+
+    std::span<const uint8_t> getData(const Entry &entry) const {return m_archives[entry.archive]->getData(*entry.info);}
+
+    WasType getType(const Entry &entry) const {return m_archives[entry.archive]->getType(*entry.info);}
+
+    std::string_view getName(const Entry &entry) const {return m_archives[entry.archive]->getName(*entry.info);}
+
+    // 识别各文件中尚未识别类型的条目
+    void sniffAll(int threads = 0) const;
+
+    // 各文件实际读取过类型的条目数之和（含被覆盖的条目）
+    size_t sniffedCount() const;
+
+    // 名称列表只计算一次 hash，再分别用于各个文件
+    size_t loadNames(const std::string &path, int threads = 0);
+
+    const MountStats &mountStats() const {return m_stats;}
+
+    // 合并索引与各文件索引占用的内存，不含映射
+    size_t memoryBytes() const;
+
+private:
+    std::vector<std::unique_ptr<Wdf> > m_archives;
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_slots;  // 开放寻址表，值为 m_entries 下标，空位为 EMPTY_SLOT
+    uint32_t m_slotShift {32};
+    MountStats m_stats {};
+
+    static constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+};
+
+
+#endif //WDFVFS_H